@@ -0,0 +1,205 @@
+/*******************************************************************************
+ *
+ * @file BenchFrameCache.cpp
+ *
+ ******************************************************************************/
+
+#include <algorithm>  // for max()
+#include <cstdio>     // for printf()
+#include <cstring>    // for strcmp()
+#include <filesystem> // for temp_directory_path()
+#include <fstream>
+#include <iterator> // for prev()
+#include <list>
+#include <random>
+#include <set>
+#include <sstream>
+#include <unordered_map>
+
+#include "poseGenerator.hpp"
+
+/*
+ * Decoded-frame cache simulator. Generates a shuffled pose order for a synthetic trace and
+ * replays it against a cache of decoded frames of a given capacity, once with LRU eviction
+ * and once with Belady's optimal eviction driven by the next-use hints of
+ * PoseGenerator::computeNextUse(). Prints the hit rate of both per cache size and delivery
+ * mode as CSV; a miss is a frame decode.
+ *
+ * Usage: bench_frameCache [--frames N] [--max-use-count N] [--cache-sizes A,B,...]
+ *                         [--seed N]
+ */
+
+namespace
+{
+
+const PoseGenerator::perturbParams cacheParams{
+    .shift        = {"gaussian", 0.5, 0.34},
+    .rotation     = {"uniform", 8.0, 1.0},
+    .forward      = {"gaussian", 0.8, 0.5},
+    .sensor_yaw   = {"gaussian", 5.0, 3.0},
+    .sensor_pitch = {"uniform", 6.0, 3.0},
+    .sensor_roll  = {"gaussian", 2.0, 1.5},
+    .flip         = true,
+};
+
+std::string syntheticTrace(uint32_t numFrames)
+{
+    std::string fileName = (std::filesystem::temp_directory_path() /
+                            ("poseGeneratorFrameCache_" + std::to_string(numFrames) + ".csv"))
+                               .string();
+    if (!std::filesystem::exists(fileName))
+    {
+        std::ofstream out(fileName);
+        out << "road_type,user_label\n";
+        for (uint32_t i = 0; i < numFrames; ++i)
+        {
+            out << "local,stable\n";
+        }
+    }
+    return fileName;
+}
+
+// Returns the number of hits of an LRU cache holding up to capacity decoded frames.
+uint64_t simulateLru(const std::vector<Augmenter::Pose>& poses, size_t capacity)
+{
+    std::list<uint32_t> recency; // most recently used first
+    std::unordered_map<uint32_t, std::list<uint32_t>::iterator> cached;
+    uint64_t hits = 0;
+    for (const auto& pose : poses)
+    {
+        auto entry = cached.find(pose.srcFrame);
+        if (entry != cached.end())
+        {
+            ++hits;
+            recency.splice(recency.begin(), recency, entry->second);
+            continue;
+        }
+        if (capacity == 0)
+        {
+            continue;
+        }
+        if (cached.size() == capacity)
+        {
+            cached.erase(recency.back());
+            recency.pop_back();
+        }
+        recency.push_front(pose.srcFrame);
+        cached[pose.srcFrame] = recency.begin();
+    }
+    return hits;
+}
+
+// Returns the number of hits of a cache holding up to capacity decoded frames that evicts the
+// frame needed furthest in the future (Belady's MIN), using precomputed next uses.
+uint64_t simulateBelady(const std::vector<Augmenter::Pose>& poses,
+                        const std::vector<uint32_t>& nextUse,
+                        size_t capacity)
+{
+    std::set<std::pair<uint32_t, uint32_t>> byNextUse; // (next use, frame)
+    std::unordered_map<uint32_t, uint32_t> cached;     // frame -> next use
+    uint64_t hits = 0;
+    for (size_t i = 0; i < poses.size(); ++i)
+    {
+        const uint32_t frame = poses[i].srcFrame;
+        auto entry           = cached.find(frame);
+        if (entry != cached.end())
+        {
+            ++hits;
+            byNextUse.erase({entry->second, frame});
+            cached.erase(entry);
+        }
+        else if (capacity == 0)
+        {
+            continue;
+        }
+        else if (cached.size() == capacity)
+        {
+            auto furthest = std::prev(byNextUse.end());
+            cached.erase(furthest->second);
+            byNextUse.erase(furthest);
+        }
+        // Frames that are not needed again are not worth keeping.
+        if (nextUse[i] != PoseGenerator::kNoReuse)
+        {
+            byNextUse.insert({nextUse[i], frame});
+            cached[frame] = nextUse[i];
+        }
+    }
+    return hits;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    uint32_t numFrames   = 10000;
+    uint32_t maxUseCount = 8;
+    std::vector<size_t> cacheSizes = {16, 64, 256, 1024, 4096};
+    unsigned int seed = 1;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const bool hasValue = i + 1 < argc;
+        if (!std::strcmp(argv[i], "--frames") && hasValue)
+        {
+            numFrames = std::stoul(argv[++i]);
+        }
+        else if (!std::strcmp(argv[i], "--max-use-count") && hasValue)
+        {
+            maxUseCount = std::max(1ul, std::stoul(argv[++i]));
+        }
+        else if (!std::strcmp(argv[i], "--cache-sizes") && hasValue)
+        {
+            cacheSizes.clear();
+            std::stringstream list(argv[++i]);
+            std::string size;
+            while (std::getline(list, size, ','))
+            {
+                cacheSizes.push_back(std::stoul(size));
+            }
+        }
+        else if (!std::strcmp(argv[i], "--seed") && hasValue)
+        {
+            seed = std::stoul(argv[++i]);
+        }
+        else
+        {
+            std::fprintf(stderr,
+                         "usage: %s [--frames N] [--max-use-count N] [--cache-sizes A,B,...] "
+                         "[--seed N]\n",
+                         argv[0]);
+            return 1;
+        }
+    }
+
+    // Use counts uniform in [0, maxUseCount], as a sampler drawing frames per epoch would.
+    std::mt19937 random(seed);
+    std::uniform_int_distribution<uint32_t> useCount(0, maxUseCount);
+    std::vector<uint32_t> vecUseCounts(numFrames);
+    for (auto& count : vecUseCounts)
+    {
+        count = useCount(random);
+    }
+    const std::string labelsFileName = syntheticTrace(numFrames);
+
+    std::printf("mode,cache_size,poses,frame_decodes_min,lru_hit_rate,belady_hit_rate\n");
+    for (auto mode : {PoseGenerator::ShufflePoses, PoseGenerator::ShuffleFrameGroups})
+    {
+        PoseGenerator generator({{"road_type=local", cacheParams}}, {"center"}, seed);
+        generator.setDeliveryMode(mode);
+        std::vector<uint32_t> nextUse;
+        const std::vector<Augmenter::Pose> poses =
+            generator.generateShuffledPoses(vecUseCounts, labelsFileName, nextUse);
+        const auto& statistics = generator.getDeliveryStatistics();
+        for (size_t cacheSize : cacheSizes)
+        {
+            const double numPoses = std::max<size_t>(poses.size(), 1);
+            std::printf("%s,%zu,%zu,%llu,%.4f,%.4f\n",
+                        mode == PoseGenerator::ShufflePoses ? "poses" : "frame_groups", cacheSize,
+                        poses.size(), static_cast<unsigned long long>(statistics.numFrames),
+                        simulateLru(poses, cacheSize) / numPoses,
+                        simulateBelady(poses, nextUse, cacheSize) / numPoses);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,236 @@
+/*******************************************************************************
+ *
+ * @file BenchPoseGenerator.cpp
+ *
+ ******************************************************************************/
+
+#include <cstdio>     // for fprintf()
+#include <filesystem> // for temp_directory_path()
+#include <fstream>
+#include <memory>
+
+#include <benchmark/benchmark.h>
+
+#include "perfCounters.hpp"
+#include "poseGenerator.hpp"
+
+namespace
+{
+
+PoseGenerator::perturbParams benchParams{
+    .shift        = {"gaussian", 0.5, 0.34},
+    .rotation     = {"uniform", 8.0, 1.0},
+    .forward      = {"gaussian", 0.8, 0.5},
+    .sensor_yaw   = {"gaussian", 5.0, 3.0},
+    .sensor_pitch = {"uniform", 6.0, 3.0},
+    .sensor_roll  = {"gaussian", 2.0, 1.5},
+    .flip         = true,
+};
+
+std::vector<std::pair<std::string, PoseGenerator::perturbParams>> benchRules()
+{
+    return {{"road_type=highway user_label=stable", benchParams},
+            {"road_type=local user_label=stable", benchParams}};
+}
+
+std::vector<std::string> benchSensorNames(uint32_t numSensors)
+{
+    std::vector<std::string> names;
+    for (uint32_t i = 0; i < numSensors; ++i)
+    {
+        names.push_back("sensor" + std::to_string(i));
+    }
+    return names;
+}
+
+// Writes (once per frame count) a synthetic label file alternating between the two rules.
+std::string syntheticLabels(uint32_t numFrames)
+{
+    std::string fileName = (std::filesystem::temp_directory_path() /
+                            ("poseGeneratorBench_" + std::to_string(numFrames) + ".csv"))
+                               .string();
+    if (!std::filesystem::exists(fileName))
+    {
+        std::ofstream out(fileName);
+        out << "road_type,user_label\n";
+        for (uint32_t i = 0; i < numFrames; ++i)
+        {
+            out << ((i / 64) % 2 ? "local" : "highway") << ",stable\n";
+        }
+    }
+    return fileName;
+}
+
+// Process-wide counters: opened once so every benchmark reports the same set of events.
+PerfCounters& counters()
+{
+    static PerfCounters perfCounters;
+    static bool warned = false;
+    if (!perfCounters.isAvailable() && !warned)
+    {
+        std::fprintf(stderr, "perf counters unavailable (%s), reporting timings only\n",
+                     perfCounters.unavailableReason().c_str());
+        warned = true;
+    }
+    return perfCounters;
+}
+
+// Adds <event>/pose counters for every event that could be collected.
+void reportPerPose(benchmark::State& state, const PerfCounters& perf, double numPoses)
+{
+    state.counters["poses/s"] = benchmark::Counter(numPoses, benchmark::Counter::kIsRate);
+    if (numPoses == 0)
+    {
+        return;
+    }
+    for (int i = 0; i < PerfCounters::NumEvents; ++i)
+    {
+        auto event = static_cast<PerfCounters::Event>(i);
+        if (perf.isAvailable(event))
+        {
+            state.counters[std::string(PerfCounters::name(event)) + "/pose"] =
+                static_cast<double>(perf.value(event)) / numPoses;
+        }
+    }
+    if (perf.isAvailable(PerfCounters::Cycles) && perf.isAvailable(PerfCounters::Instructions) &&
+        perf.value(PerfCounters::Cycles) > 0)
+    {
+        state.counters["IPC"] = static_cast<double>(perf.value(PerfCounters::Instructions)) /
+                                static_cast<double>(perf.value(PerfCounters::Cycles));
+    }
+}
+
+void BM_GenerateOnePose(benchmark::State& state)
+{
+    PoseGenerator generator(benchRules(), benchSensorNames(state.range(0)), 1);
+    PerfCounters& perf = counters();
+
+    perf.start();
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(generator.generateOnePose(benchParams));
+    }
+    perf.stop();
+
+    reportPerPose(state, perf, static_cast<double>(state.iterations()));
+}
+BENCHMARK(BM_GenerateOnePose)->Arg(1)->Arg(3)->Arg(8);
+
+void BM_GeneratePoses4vecFrames(benchmark::State& state)
+{
+    const uint32_t numFrames = state.range(0);
+    const std::string labels = syntheticLabels(numFrames);
+    PoseGenerator generator(benchRules(), benchSensorNames(3), 1);
+    std::vector<uint32_t> vecUseCounts(numFrames, 2);
+    PerfCounters& perf = counters();
+
+    // Second argument toggles streaming statistics, to keep their overhead visible.
+    generator.enableStatistics(state.range(1) != 0);
+
+    perf.start();
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(generator.generatePoses4vecFrames(vecUseCounts, labels));
+    }
+    perf.stop();
+
+    reportPerPose(state, perf, static_cast<double>(state.iterations()) * numFrames * 2);
+}
+BENCHMARK(BM_GeneratePoses4vecFrames)
+    ->ArgsProduct({{1000, 10000}, {0, 1}})
+    ->ArgNames({"frames", "stats"})
+    ->Unit(benchmark::kMillisecond);
+
+void BM_GenerateShuffledPoses(benchmark::State& state)
+{
+    const uint32_t numFrames = state.range(0);
+    const std::string labels = syntheticLabels(numFrames);
+    PoseGenerator generator(benchRules(), benchSensorNames(3), 1);
+    std::vector<uint32_t> vecUseCounts(numFrames, 2);
+    PerfCounters& perf = counters();
+
+    perf.start();
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(generator.generateShuffledPoses(vecUseCounts, labels));
+    }
+    perf.stop();
+
+    reportPerPose(state, perf, static_cast<double>(state.iterations()) * numFrames * 2);
+}
+BENCHMARK(BM_GenerateShuffledPoses)->Arg(1000)->Arg(10000)->Unit(benchmark::kMillisecond);
+
+void BM_GenerateEpochs(benchmark::State& state)
+{
+    const uint32_t numFrames = 10000;
+    const uint32_t numEpochs = state.range(0);
+    const std::string labels = syntheticLabels(numFrames);
+    PoseGenerator generator(benchRules(), benchSensorNames(3), 1);
+    std::vector<uint32_t> vecUseCounts(numFrames, 2);
+    PerfCounters& perf = counters();
+
+    // Poses per second should approach the shuffle-only rate as epochs share label work.
+    perf.start();
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(generator.generateEpochs(vecUseCounts, labels, numEpochs));
+    }
+    perf.stop();
+
+    reportPerPose(state, perf, static_cast<double>(state.iterations()) * numFrames * 2 * numEpochs);
+}
+BENCHMARK(BM_GenerateEpochs)->Arg(1)->Arg(4)->Arg(16)->Unit(benchmark::kMillisecond);
+
+void BM_GenerateEnsemble(benchmark::State& state)
+{
+    const uint32_t numFrames = 10000;
+    const uint32_t numSeeds  = state.range(0);
+    const std::string labels = syntheticLabels(numFrames);
+    std::vector<uint32_t> vecUseCounts(numFrames, 2);
+    std::vector<uint64_t> seeds(numSeeds);
+    for (uint32_t i = 0; i < numSeeds; ++i)
+    {
+        seeds[i] = i + 1;
+    }
+    PerfCounters& perf = counters();
+
+    // Second argument: 0 runs one PoseGenerator per seed for comparison, 1 runs one ensemble,
+    // 2 runs one ensemble and builds every pose of every set from it.
+    const int64_t mode = state.range(1);
+    perf.start();
+    for (auto _ : state)
+    {
+        if (mode == 0)
+        {
+            // Keep every set, as the ensemble does.
+            std::vector<std::vector<Augmenter::Pose>> sets;
+            for (uint64_t seed : seeds)
+            {
+                PoseGenerator generator(benchRules(), benchSensorNames(3), seed);
+                sets.push_back(generator.generateShuffledPoses(vecUseCounts, labels));
+            }
+            benchmark::DoNotOptimize(sets);
+        }
+        else
+        {
+            PoseGenerator generator(benchRules(), benchSensorNames(3), 1);
+            PoseEnsemble ensemble = generator.generateEnsemble(vecUseCounts, labels, seeds);
+            for (size_t set = 0; mode == 2 && set < ensemble.size(); ++set)
+            {
+                benchmark::DoNotOptimize(ensemble.getPoses(set));
+            }
+            benchmark::DoNotOptimize(ensemble);
+        }
+    }
+    perf.stop();
+
+    reportPerPose(state, perf, static_cast<double>(state.iterations()) * numFrames * 2 * numSeeds);
+}
+BENCHMARK(BM_GenerateEnsemble)
+    ->ArgsProduct({{4, 16}, {0, 1, 2}})
+    ->ArgNames({"seeds", "mode"})
+    ->Unit(benchmark::kMillisecond);
+
+} // namespace
+
+BENCHMARK_MAIN();
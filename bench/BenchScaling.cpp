@@ -0,0 +1,355 @@
+/*******************************************************************************
+ *
+ * @file BenchScaling.cpp
+ *
+ ******************************************************************************/
+
+#include <chrono>     // for chrono::steady_clock
+#include <cstdio>     // for fprintf()
+#include <cstring>    // for strcmp()
+#include <filesystem> // for temp_directory_path()
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <thread>
+
+#include "poseGenerator.hpp"
+
+/*
+ * Scaling benchmark for PoseGenerator. Sweeps one axis at a time around a base configuration
+ * (threads, frames, sensors, rules, use-count distribution), or the full cartesian product
+ * with --full, and writes poses/s and peak RSS per configuration as CSV or JSON.
+ *
+ * Every thread owns a PoseGenerator and a synthetic trace of frames/threads rows, which is
+ * how data loader workers use it. Peak RSS is reset before each configuration through
+ * /proc/self/clear_refs, so the reported value belongs to that configuration only.
+ *
+ * Usage: bench_poseScaling [--max-threads N] [--max-frames N] [--format csv|json]
+ *                          [--output FILE] [--full]
+ */
+
+namespace
+{
+
+struct scalingConfig
+{
+    std::string axis;
+    uint32_t threads;
+    uint64_t frames;
+    uint32_t sensors;
+    uint32_t rules;
+    std::string distribution;
+};
+
+struct scalingResult
+{
+    scalingConfig config;
+    uint64_t poses;
+    double seconds;
+    uint64_t peakRssKb;
+};
+
+const PoseGenerator::perturbParams scalingParams{
+    .shift        = {"gaussian", 0.5, 0.34},
+    .rotation     = {"uniform", 8.0, 1.0},
+    .forward      = {"gaussian", 0.8, 0.5},
+    .sensor_yaw   = {"gaussian", 5.0, 3.0},
+    .sensor_pitch = {"uniform", 6.0, 3.0},
+    .sensor_roll  = {"gaussian", 2.0, 1.5},
+    .flip         = true,
+};
+
+// Frame i of a synthetic trace carries scene "scene<i % rules>", so frames spread evenly over
+// the rules and first-match resolution scans half of the rule list on average.
+std::string syntheticTrace(uint64_t numFrames, uint32_t numRules)
+{
+    std::string fileName = (std::filesystem::temp_directory_path() /
+                            ("poseGeneratorScaling_" + std::to_string(numFrames) + "_" +
+                             std::to_string(numRules) + ".csv"))
+                               .string();
+    if (!std::filesystem::exists(fileName))
+    {
+        std::ofstream out(fileName);
+        out << "road_type,user_label,scene\n";
+        for (uint64_t i = 0; i < numFrames; ++i)
+        {
+            out << "local,stable,scene" << (i % numRules) << "\n";
+        }
+    }
+    return fileName;
+}
+
+std::vector<std::pair<std::string, PoseGenerator::perturbParams>> syntheticRules(uint32_t numRules)
+{
+    std::vector<std::pair<std::string, PoseGenerator::perturbParams>> rules;
+    for (uint32_t r = 0; r < numRules; ++r)
+    {
+        rules.push_back({"road_type=local scene=scene" + std::to_string(r), scalingParams});
+    }
+    return rules;
+}
+
+std::vector<uint32_t> syntheticUseCounts(uint64_t numFrames, const std::string& distribution,
+                                         unsigned int seed)
+{
+    std::mt19937_64 generator(seed);
+    std::vector<uint32_t> useCounts(numFrames, 2);
+    if (distribution == "poisson")
+    {
+        std::poisson_distribution<uint32_t> poisson(2.0);
+        for (auto& count : useCounts)
+        {
+            count = poisson(generator);
+        }
+    }
+    else if (distribution == "sparse")
+    {
+        // 10% of the frames are sampled 8 times, the rest not at all.
+        std::bernoulli_distribution sampled(0.1);
+        for (auto& count : useCounts)
+        {
+            count = sampled(generator) ? 8 : 0;
+        }
+    }
+    return useCounts;
+}
+
+void resetPeakRss()
+{
+    std::ofstream clearRefs("/proc/self/clear_refs");
+    clearRefs << "5";
+}
+
+uint64_t peakRssKb()
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line))
+    {
+        if (line.rfind("VmHWM:", 0) == 0)
+        {
+            return std::stoull(line.substr(6));
+        }
+    }
+    return 0;
+}
+
+scalingResult runConfig(const scalingConfig& config)
+{
+    const uint64_t framesPerThread = std::max<uint64_t>(config.frames / config.threads, 1);
+    const std::string labels = syntheticTrace(framesPerThread, config.rules);
+    const auto rules = syntheticRules(config.rules);
+    std::vector<std::string> sensorNames;
+    for (uint32_t s = 0; s < config.sensors; ++s)
+    {
+        sensorNames.push_back("sensor" + std::to_string(s));
+    }
+
+    resetPeakRss();
+    std::vector<uint64_t> posesPerThread(config.threads, 0);
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (uint32_t t = 0; t < config.threads; ++t)
+    {
+        workers.emplace_back([&, t]() {
+            PoseGenerator generator(rules, sensorNames, t + 1);
+            std::vector<uint32_t> useCounts =
+                syntheticUseCounts(framesPerThread, config.distribution, t + 1);
+            posesPerThread[t] = generator.generateShuffledPoses(useCounts, labels).size();
+        });
+    }
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+    const double seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    scalingResult result = {config, 0, seconds, peakRssKb()};
+    for (uint64_t poses : posesPerThread)
+    {
+        result.poses += poses;
+    }
+    return result;
+}
+
+std::vector<scalingConfig> buildConfigs(uint32_t maxThreads, uint64_t maxFrames, bool full)
+{
+    std::vector<uint32_t> threads;
+    for (uint32_t t = 1; t <= maxThreads; t *= 2)
+    {
+        threads.push_back(t);
+    }
+    std::vector<uint64_t> frames;
+    for (uint64_t f = 1000; f <= maxFrames; f *= 10)
+    {
+        frames.push_back(f);
+    }
+    const std::vector<uint32_t> sensors = {1, 4, 16, 64};
+    const std::vector<uint32_t> rules = {1, 10, 100, 1000};
+    const std::vector<std::string> distributions = {"constant", "poisson", "sparse"};
+
+    const scalingConfig base = {"base", 1, std::min<uint64_t>(10000, maxFrames), 3, 2, "constant"};
+    std::vector<scalingConfig> configs;
+    if (full)
+    {
+        for (uint32_t t : threads)
+        {
+            for (uint64_t f : frames)
+            {
+                for (uint32_t s : sensors)
+                {
+                    for (uint32_t r : rules)
+                    {
+                        for (const auto& d : distributions)
+                        {
+                            configs.push_back({"full", t, f, s, r, d});
+                        }
+                    }
+                }
+            }
+        }
+        return configs;
+    }
+    // Thread sweep is weak scaling: every thread gets a trace of the base size.
+    for (uint32_t t : threads)
+    {
+        scalingConfig c = base;
+        c.axis = "threads";
+        c.threads = t;
+        c.frames = base.frames * t;
+        configs.push_back(c);
+    }
+    for (uint64_t f : frames)
+    {
+        scalingConfig c = base;
+        c.axis = "frames";
+        c.frames = f;
+        configs.push_back(c);
+    }
+    for (uint32_t s : sensors)
+    {
+        scalingConfig c = base;
+        c.axis = "sensors";
+        c.sensors = s;
+        configs.push_back(c);
+    }
+    for (uint32_t r : rules)
+    {
+        scalingConfig c = base;
+        c.axis = "rules";
+        c.rules = r;
+        configs.push_back(c);
+    }
+    for (const auto& d : distributions)
+    {
+        scalingConfig c = base;
+        c.axis = "distribution";
+        c.distribution = d;
+        configs.push_back(c);
+    }
+    return configs;
+}
+
+void writeCsv(std::ostream& out, const std::vector<scalingResult>& results)
+{
+    out << "axis,threads,frames,sensors,rules,distribution,poses,seconds,poses_per_sec,"
+           "peak_rss_kb\n";
+    for (const auto& r : results)
+    {
+        out << r.config.axis << "," << r.config.threads << "," << r.config.frames << ","
+            << r.config.sensors << "," << r.config.rules << "," << r.config.distribution << ","
+            << r.poses << "," << r.seconds << "," << (r.seconds > 0 ? r.poses / r.seconds : 0)
+            << "," << r.peakRssKb << "\n";
+    }
+}
+
+void writeJson(std::ostream& out, const std::vector<scalingResult>& results)
+{
+    out << "[\n";
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const auto& r = results[i];
+        out << "  {\"axis\": \"" << r.config.axis << "\", \"threads\": " << r.config.threads
+            << ", \"frames\": " << r.config.frames << ", \"sensors\": " << r.config.sensors
+            << ", \"rules\": " << r.config.rules << ", \"distribution\": \""
+            << r.config.distribution << "\", \"poses\": " << r.poses
+            << ", \"seconds\": " << r.seconds
+            << ", \"poses_per_sec\": " << (r.seconds > 0 ? r.poses / r.seconds : 0)
+            << ", \"peak_rss_kb\": " << r.peakRssKb << "}"
+            << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "]\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    uint32_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    uint64_t maxFrames = 1000000;
+    std::string format = "csv";
+    std::string output;
+    bool full = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const bool hasValue = i + 1 < argc;
+        if (!std::strcmp(argv[i], "--max-threads") && hasValue)
+        {
+            maxThreads = std::stoul(argv[++i]);
+        }
+        else if (!std::strcmp(argv[i], "--max-frames") && hasValue)
+        {
+            maxFrames = std::stoull(argv[++i]);
+        }
+        else if (!std::strcmp(argv[i], "--format") && hasValue)
+        {
+            format = argv[++i];
+        }
+        else if (!std::strcmp(argv[i], "--output") && hasValue)
+        {
+            output = argv[++i];
+        }
+        else if (!std::strcmp(argv[i], "--full"))
+        {
+            full = true;
+        }
+        else
+        {
+            std::fprintf(stderr,
+                         "usage: %s [--max-threads N] [--max-frames N] [--format csv|json] "
+                         "[--output FILE] [--full]\n",
+                         argv[0]);
+            return 1;
+        }
+    }
+
+    std::vector<scalingResult> results;
+    for (const auto& config : buildConfigs(maxThreads, maxFrames, full))
+    {
+        results.push_back(runConfig(config));
+        std::fprintf(stderr, "%s: threads=%u frames=%llu sensors=%u rules=%u %s -> %.0f poses/s\n",
+                     config.axis.c_str(), config.threads,
+                     static_cast<unsigned long long>(config.frames), config.sensors,
+                     config.rules, config.distribution.c_str(),
+                     results.back().poses / std::max(results.back().seconds, 1e-9));
+    }
+
+    std::ofstream file;
+    if (!output.empty())
+    {
+        file.open(output);
+    }
+    std::ostream& out = output.empty() ? std::cout : file;
+    if (format == "json")
+    {
+        writeJson(out, results);
+    }
+    else
+    {
+        writeCsv(out, results);
+    }
+    return 0;
+}
@@ -0,0 +1,178 @@
+/*******************************************************************************
+ *
+ * @file perfCounters.cpp
+ *
+ ******************************************************************************/
+
+#include <cerrno>  // for errno
+#include <cstdlib> // for getenv()
+#include <cstring> // for strerror(), memset()
+
+#include "perfCounters.hpp"
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+
+#if defined(__linux__)
+int openEvent(uint32_t type, uint64_t config)
+{
+    struct perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size           = sizeof(attr);
+    attr.type           = type;
+    attr.config         = config;
+    attr.disabled       = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+    // Counters may be multiplexed when more events are requested than the PMU supports;
+    // enabled/running times let us scale the raw count back up.
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    return static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+}
+#endif
+
+} // namespace
+
+PerfCounters::PerfCounters()
+{
+    m_fds.fill(-1);
+    m_values.fill(0);
+
+    // Allow turning counters off explicitly, e.g. on machines where they perturb timings.
+    const char* env = std::getenv("POSEGEN_PERF_COUNTERS");
+    if (env && std::string(env) == "0")
+    {
+        m_unavailableReason = "disabled by POSEGEN_PERF_COUNTERS=0";
+        return;
+    }
+
+#if defined(__linux__)
+    const std::array<std::pair<uint32_t, uint64_t>, NumEvents> events = {{
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    }};
+    for (int i = 0; i < NumEvents; ++i)
+    {
+        m_fds[i] = openEvent(events[i].first, events[i].second);
+        if (m_fds[i] < 0 && m_unavailableReason.empty())
+        {
+            m_unavailableReason = std::string(name(static_cast<Event>(i))) + ": " +
+                                  std::strerror(errno);
+        }
+    }
+#else
+    m_unavailableReason = "perf_event_open() is only available on Linux";
+#endif
+}
+
+PerfCounters::~PerfCounters()
+{
+#if defined(__linux__)
+    for (int fd : m_fds)
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+    }
+#endif
+}
+
+bool PerfCounters::isAvailable() const
+{
+    for (int i = 0; i < NumEvents; ++i)
+    {
+        if (isAvailable(static_cast<Event>(i)))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool PerfCounters::isAvailable(Event event) const
+{
+    return m_fds[event] >= 0;
+}
+
+void PerfCounters::start()
+{
+#if defined(__linux__)
+    for (int fd : m_fds)
+    {
+        if (fd >= 0)
+        {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+#endif
+}
+
+void PerfCounters::stop()
+{
+#if defined(__linux__)
+    for (int fd : m_fds)
+    {
+        if (fd >= 0)
+        {
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+    for (int i = 0; i < NumEvents; ++i)
+    {
+        m_values[i] = 0;
+        if (m_fds[i] < 0)
+        {
+            continue;
+        }
+        // Layout given by read_format: value, time_enabled, time_running.
+        uint64_t data[3] = {0, 0, 0};
+        if (read(m_fds[i], data, sizeof(data)) != static_cast<ssize_t>(sizeof(data)) ||
+            data[2] == 0)
+        {
+            continue;
+        }
+        m_values[i] = static_cast<uint64_t>(static_cast<double>(data[0]) *
+                                            static_cast<double>(data[1]) /
+                                            static_cast<double>(data[2]));
+    }
+#endif
+}
+
+uint64_t PerfCounters::value(Event event) const
+{
+    return m_values[event];
+}
+
+const char* PerfCounters::name(Event event)
+{
+    switch (event)
+    {
+    case Cycles:
+        return "cycles";
+    case Instructions:
+        return "instructions";
+    case LlcMisses:
+        return "LLC-misses";
+    case BranchMisses:
+        return "branch-misses";
+    default:
+        return "unknown";
+    }
+}
+
+const std::string& PerfCounters::unavailableReason() const
+{
+    return m_unavailableReason;
+}
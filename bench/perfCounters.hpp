@@ -0,0 +1,96 @@
+/*******************************************************************************
+ *
+ * @file perfCounters.hpp
+ *
+ ******************************************************************************/
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief
+ * Thin wrapper around Linux perf_event_open() that counts hardware events for the calling
+ * thread. Each event is opened independently so that a missing counter (e.g. LLC misses in
+ * a VM) only disables that counter. When perf events are not available at all (non-Linux,
+ * perf_event_paranoid, containers) every counter reports as unavailable and start()/stop()
+ * are no-ops, so benchmarks keep running without counter output.
+ */
+class PerfCounters
+{
+public:
+    /* Hardware events collected by the benchmarks. */
+    enum Event
+    {
+        Cycles = 0,
+        Instructions,
+        LlcMisses,
+        BranchMisses,
+        NumEvents
+    };
+
+    PerfCounters();
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    /**
+     * @brief
+     * Returns true if at least one event could be opened.
+     */
+    bool isAvailable() const;
+
+    /**
+     * @brief
+     * Returns true if the given event could be opened.
+     *
+     * @param[in] event         : the hardware event to query.
+     */
+    bool isAvailable(Event event) const;
+
+    /**
+     * @brief
+     * Resets and enables all opened counters.
+     */
+    void start();
+
+    /**
+     * @brief
+     * Disables all opened counters and latches their (multiplexing-scaled) values.
+     */
+    void stop();
+
+    /**
+     * @brief
+     * Returns the value latched by the last stop() call, or 0 if the event is unavailable.
+     *
+     * @param[in] event         : the hardware event to query.
+     */
+    uint64_t value(Event event) const;
+
+    /**
+     * @brief
+     * Returns a short, human-readable name of the given event, e.g. "cycles".
+     *
+     * @param[in] event         : the hardware event to query.
+     */
+    static const char* name(Event event);
+
+    /**
+     * @brief
+     * Returns why counters are unavailable (empty if all events were opened).
+     */
+    const std::string& unavailableReason() const;
+
+private:
+    /* File descriptor per event, -1 if the event could not be opened. */
+    std::array<int, NumEvents> m_fds;
+
+    /* Values latched by stop(). */
+    std::array<uint64_t, NumEvents> m_values;
+
+    /* Reason for the first failure to open an event. */
+    std::string m_unavailableReason;
+};
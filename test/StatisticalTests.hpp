@@ -0,0 +1,125 @@
+/*******************************************************************************
+*
+* @file StatisticalTests.hpp
+*
+******************************************************************************/
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "poseGenerator.hpp"
+
+/*
+ * Goodness-of-fit helpers used to validate generated poses against the randParams they were
+ * drawn from: Kolmogorov-Smirnov and chi-square tests against the truncated gaussian or
+ * uniform distribution over (-max, max). Samples are kept in flat arrays and sorted in place.
+ */
+namespace statisticalTests
+{
+
+/* Cumulative distribution function of the distribution described by params. */
+inline double cdf(const PoseGenerator::randParams& params, double x)
+{
+    if (x <= -params.max)
+    {
+        return 0;
+    }
+    if (x >= params.max)
+    {
+        return 1;
+    }
+    if (params.distribution == "uniform")
+    {
+        return (x + params.max) / (2 * params.max);
+    }
+    // Gaussian truncated to (-max, max) by rejection sampling.
+    auto phi = [&](double v) { return 0.5 * std::erfc(-v / (params.stdDev * std::sqrt(2.0))); };
+    const double lo = phi(-params.max);
+    const double hi = phi(params.max);
+    return (phi(x) - lo) / (hi - lo);
+}
+
+/* Returns true if the distribution degenerates to a constant 0 (zero limit or deviation). */
+inline bool isDegenerate(const PoseGenerator::randParams& params)
+{
+    return params.max <= 0 || (params.distribution != "uniform" && params.stdDev <= 0);
+}
+
+/* Kolmogorov-Smirnov statistic D of the samples (sorted in place) against params. */
+inline double ksStatistic(std::vector<float>& samples, const PoseGenerator::randParams& params)
+{
+    std::sort(samples.begin(), samples.end());
+    const size_t n = samples.size();
+    std::vector<double> expected(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        expected[i] = cdf(params, samples[i]);
+    }
+    double d = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        const double above = static_cast<double>(i + 1) / n - expected[i];
+        const double below = expected[i] - static_cast<double>(i) / n;
+        d = std::max(d, std::max(above, below));
+    }
+    return d;
+}
+
+/* Critical value of D for n samples at significance alpha (asymptotic). */
+inline double ksCritical(size_t n, double alpha)
+{
+    return std::sqrt(-std::log(alpha / 2) / 2) / std::sqrt(static_cast<double>(n));
+}
+
+/*
+ * Chi-square statistic over equal-width bins spanning (-max, max). Adjacent bins are merged
+ * until every bin expects at least 5 samples; the number of merged bins is returned in
+ * numBins.
+ */
+inline double chiSquareStatistic(const std::vector<float>& samples,
+                                 const PoseGenerator::randParams& params, uint32_t& numBins)
+{
+    const uint32_t kBins = 32;
+    std::vector<double> observed(kBins, 0);
+    const double width = 2 * params.max / kBins;
+    for (float value : samples)
+    {
+        int bin = static_cast<int>((value + params.max) / width);
+        observed[std::min(std::max(bin, 0), static_cast<int>(kBins) - 1)] += 1;
+    }
+
+    double chi2 = 0;
+    double obsAcc = 0;
+    double expAcc = 0;
+    numBins = 0;
+    for (uint32_t b = 0; b < kBins; ++b)
+    {
+        obsAcc += observed[b];
+        expAcc += samples.size() *
+                  (cdf(params, -params.max + (b + 1) * width) - cdf(params, -params.max + b * width));
+        if (expAcc >= 5 || b + 1 == kBins)
+        {
+            if (expAcc > 0)
+            {
+                chi2 += (obsAcc - expAcc) * (obsAcc - expAcc) / expAcc;
+                ++numBins;
+            }
+            obsAcc = 0;
+            expAcc = 0;
+        }
+    }
+    return chi2;
+}
+
+/* Critical chi-square value for numBins - 1 degrees of freedom (Wilson-Hilferty), z = 3.09
+ * corresponds to alpha = 0.001. */
+inline double chiSquareCritical(uint32_t numBins, double z = 3.09)
+{
+    const double k = std::max(1u, numBins - 1);
+    const double t = 1 - 2 / (9 * k) + z * std::sqrt(2 / (9 * k));
+    return k * t * t * t;
+}
+
+} // namespace statisticalTests
@@ -0,0 +1,274 @@
+/*******************************************************************************
+*
+* @file TestPerfRegression.cpp
+*
+******************************************************************************/
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <new>
+#include <sstream>
+
+#include "gtest/gtest.h"
+#include "poseGenerator.hpp"
+
+/*
+ * Performance regression mode of test_poseGenerator. Skipped unless POSEGEN_PERF_REGRESSION
+ * is set:
+ *   POSEGEN_PERF_REGRESSION=1       compare against the committed baseline and fail on
+ *                                   regressions beyond the per-workload tolerance.
+ *   POSEGEN_PERF_REGRESSION=update  measure and rewrite the baseline file.
+ * The baseline path defaults to test/data/poseGeneratorPerfBaseline.csv and can be
+ * overridden with POSEGEN_PERF_BASELINE.
+ */
+
+namespace
+{
+
+// Allocation counting is only active while a workload is being measured.
+std::atomic<bool> countAllocations{false};
+std::atomic<uint64_t> numAllocations{0};
+
+} // namespace
+
+void* operator new(std::size_t size)
+{
+    if (countAllocations.load(std::memory_order_relaxed))
+    {
+        numAllocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (void* ptr = std::malloc(size ? size : 1))
+    {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+namespace
+{
+
+struct perfMeasurement
+{
+    double posesPerSec;
+    double allocsPerPose;
+};
+
+struct perfBaseline
+{
+    perfMeasurement expected;
+    double tolerance;
+};
+
+std::string perfMode()
+{
+    const char* env = std::getenv("POSEGEN_PERF_REGRESSION");
+    return env ? env : "";
+}
+
+std::string baselineFileName()
+{
+    const char* env = std::getenv("POSEGEN_PERF_BASELINE");
+#ifdef POSEGEN_PERF_BASELINE
+    return env ? env : POSEGEN_PERF_BASELINE;
+#else
+    return env ? env : "data/poseGeneratorPerfBaseline.csv";
+#endif
+}
+
+// Baseline format: "workload,poses_per_sec,allocs_per_pose,tolerance", '#' starts a comment.
+std::map<std::string, perfBaseline> readBaseline(const std::string& fileName)
+{
+    std::map<std::string, perfBaseline> baseline;
+    std::ifstream in(fileName);
+    std::string line;
+    while (std::getline(in, line))
+    {
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+        std::istringstream fields(line);
+        std::string name, posesPerSec, allocsPerPose, tolerance;
+        std::getline(fields, name, ',');
+        std::getline(fields, posesPerSec, ',');
+        std::getline(fields, allocsPerPose, ',');
+        std::getline(fields, tolerance, ',');
+        baseline[name] = {{std::stod(posesPerSec), std::stod(allocsPerPose)}, std::stod(tolerance)};
+    }
+    return baseline;
+}
+
+// Runs the workload a few times and keeps the fastest run, which is the least noisy estimate.
+template <typename Workload>
+perfMeasurement measure(uint64_t numPoses, Workload workload)
+{
+    perfMeasurement best = {0, 0};
+    for (int run = 0; run < 3; ++run)
+    {
+        numAllocations = 0;
+        countAllocations = true;
+        const auto start = std::chrono::steady_clock::now();
+        workload();
+        const double seconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        countAllocations = false;
+
+        best.posesPerSec = std::max(best.posesPerSec, numPoses / seconds);
+        best.allocsPerPose = static_cast<double>(numAllocations) / numPoses;
+    }
+    return best;
+}
+
+class PoseGeneratorPerfTest : public ::testing::Test
+{
+protected:
+    PoseGenerator::perturbParams perfParams{
+        .shift        = {"gaussian", 0.5, 0.34},
+        .rotation     = {"uniform", 8.0, 1.0},
+        .forward      = {"gaussian", 0.8, 0.5},
+        .sensor_yaw   = {"gaussian", 5.0, 3.0},
+        .sensor_pitch = {"uniform", 6.0, 3.0},
+        .sensor_roll  = {"gaussian", 2.0, 1.5},
+        .flip         = true,
+    };
+    std::vector<std::string> sensorNames = {"center", "pilot", "pilotPinhole"};
+
+    virtual void SetUp()
+    {
+        if (perfMode().empty())
+        {
+            GTEST_SKIP() << "set POSEGEN_PERF_REGRESSION=1 to run performance regression tests";
+        }
+        baseline = readBaseline(baselineFileName());
+    }
+
+    virtual void TearDown()
+    {
+        if (perfMode() == "update" && !measured.empty())
+        {
+            // Keep workloads measured by other tests of this run, replace ours.
+            std::map<std::string, perfBaseline> updated = readBaseline(baselineFileName());
+            for (const auto& entry : measured)
+            {
+                double tolerance = updated.count(entry.first) ? updated[entry.first].tolerance : 0.3;
+                updated[entry.first] = {entry.second, tolerance};
+            }
+            std::ofstream out(baselineFileName());
+            out << "# PoseGenerator performance baseline, see TestPerfRegression.cpp. Numbers are "
+                   "machine\n# specific: regenerate with POSEGEN_PERF_REGRESSION=update on the "
+                   "reference machine.\n# workload,poses_per_sec,allocs_per_pose,tolerance\n";
+            for (const auto& entry : updated)
+            {
+                out << entry.first << "," << static_cast<uint64_t>(entry.second.expected.posesPerSec)
+                    << "," << entry.second.expected.allocsPerPose << "," << entry.second.tolerance
+                    << "\n";
+            }
+        }
+    }
+
+    // Compares a measurement against the baseline; regressions fail with the full numbers.
+    void check(const std::string& workload, const perfMeasurement& result)
+    {
+        measured[workload] = result;
+        std::cout << "[ PERF     ] " << workload << ": " << result.posesPerSec << " poses/s, "
+                  << result.allocsPerPose << " allocs/pose" << std::endl;
+        if (perfMode() == "update")
+        {
+            return;
+        }
+        ASSERT_TRUE(baseline.count(workload)) << "no baseline for workload " << workload << " in "
+                                              << baselineFileName();
+        const perfBaseline& expected = baseline[workload];
+        EXPECT_GE(result.posesPerSec, expected.expected.posesPerSec * (1 - expected.tolerance))
+            << "PERF REGRESSION in " << workload << ": throughput " << result.posesPerSec
+            << " poses/s vs baseline " << expected.expected.posesPerSec << " (tolerance "
+            << expected.tolerance * 100 << "%)";
+        EXPECT_LE(result.allocsPerPose, expected.expected.allocsPerPose * (1 + expected.tolerance))
+            << "PERF REGRESSION in " << workload << ": " << result.allocsPerPose
+            << " allocations per pose vs baseline " << expected.expected.allocsPerPose;
+    }
+
+    // Synthetic trace whose frames match the last of numRules rules, so that rule matching
+    // scans the whole rule list for every frame.
+    std::string syntheticTrace(uint32_t numFrames, uint32_t numRules)
+    {
+        std::string fileName = (std::filesystem::temp_directory_path() /
+                                ("poseGeneratorPerf_" + std::to_string(numFrames) + "_" +
+                                 std::to_string(numRules) + ".csv"))
+                                   .string();
+        std::ofstream out(fileName);
+        out << "road_type,user_label,scene\n";
+        for (uint32_t i = 0; i < numFrames; ++i)
+        {
+            out << "local,stable,scene" << numRules - 1 << "\n";
+        }
+        return fileName;
+    }
+
+    std::vector<std::pair<std::string, PoseGenerator::perturbParams>> syntheticRules(uint32_t numRules)
+    {
+        std::vector<std::pair<std::string, PoseGenerator::perturbParams>> rules;
+        for (uint32_t r = 0; r < numRules; ++r)
+        {
+            rules.push_back({"road_type=local scene=scene" + std::to_string(r), perfParams});
+        }
+        return rules;
+    }
+
+    std::map<std::string, perfBaseline> baseline;
+    std::map<std::string, perfMeasurement> measured;
+};
+
+TEST_F(PoseGeneratorPerfTest, TestPerfGenerateOnePose_L1)
+{
+    PoseGenerator generator(syntheticRules(1), sensorNames, 1);
+    const uint64_t numPoses = 200000;
+    volatile float sink = 0;
+    check("generateOnePose", measure(numPoses, [&]() {
+              for (uint64_t i = 0; i < numPoses; ++i)
+              {
+                  sink = generator.generateOnePose(perfParams).shift;
+              }
+          }));
+}
+
+TEST_F(PoseGeneratorPerfTest, TestPerfRuleMatching_L1)
+{
+    // One pose per frame and many rules: the cost is dominated by resolving the rule.
+    const uint32_t numFrames = 20000;
+    const uint32_t numRules = 100;
+    const std::string labels = syntheticTrace(numFrames, numRules);
+    PoseGenerator generator(syntheticRules(numRules), sensorNames, 1);
+    std::vector<uint32_t> vecUseCounts(numFrames, 1);
+    check("ruleMatching", measure(numFrames, [&]() {
+              generator.generatePoses4vecFrames(vecUseCounts, labels);
+          }));
+}
+
+TEST_F(PoseGeneratorPerfTest, TestPerfShuffle_L1)
+{
+    const uint32_t numFrames = 20000;
+    const std::string labels = syntheticTrace(numFrames, 1);
+    PoseGenerator generator(syntheticRules(1), sensorNames, 1);
+    std::vector<uint32_t> vecUseCounts(numFrames, 4);
+    check("shuffle", measure(numFrames * 4, [&]() {
+              generator.generateShuffledPoses(vecUseCounts, labels);
+          }));
+}
+
+} // namespace
@@ -0,0 +1,292 @@
+/*******************************************************************************
+*
+* @file TestPoseDistribution.cpp
+*
+******************************************************************************/
+
+#include <cstdlib>
+#include <numeric>
+#include <thread>
+
+#include "gtest/gtest.h"
+#include "StatisticalTests.hpp"
+#include "poseGenerator.hpp"
+#include <common/TestsDataPath.hpp>
+
+namespace
+{
+
+using statisticalTests::chiSquareCritical;
+using statisticalTests::chiSquareStatistic;
+using statisticalTests::isDegenerate;
+using statisticalTests::ksCritical;
+using statisticalTests::ksStatistic;
+
+// Significance level of every goodness-of-fit test; seeds are fixed, so results are stable.
+const double kAlpha = 0.001;
+
+// Unit of the per-frame use counts; even, so flipping rules flip exactly half of every frame.
+const uint32_t kBatchUseCount = 16;
+
+/*
+ * Generates a large number of poses once (on all cores, one PoseGenerator per thread, each
+ * loading the labels once for all of its poses), keeps only flat per-rule, per-field sample
+ * arrays and counters, and shares them between the tests of this suite.
+ */
+class PoseDistributionTest : public ::testing::Test
+{
+protected:
+    static constexpr int kNumFields = PoseStatistics::NumFields;
+
+    struct ruleSamples
+    {
+        std::array<std::vector<float>, kNumFields> fields;
+        uint64_t numPoses   = 0;
+        uint64_t numFlipped = 0;
+        uint64_t numOutOfBounds = 0;
+    };
+
+    static std::vector<std::pair<std::string, PoseGenerator::perturbParams>> configRules;
+    static std::vector<std::string> sensorNames;
+    static std::vector<ruleSamples> samples;
+    static std::vector<uint64_t> expectedPoses;
+    static std::vector<int> frameRules;
+
+    static const PoseGenerator::randParams& fieldParams(const PoseGenerator::perturbParams& p,
+                                                        int field)
+    {
+        const PoseGenerator::randParams* params[kNumFields] = {
+            &p.shift, &p.rotation, &p.forward, &p.sensor_yaw, &p.sensor_pitch, &p.sensor_roll};
+        return *params[field];
+    }
+
+    // Number of poses to draw for a suite of samples.
+    static uint64_t targetPoses()
+    {
+        const char* env = std::getenv("POSEGEN_STAT_POSES");
+        return env ? std::stoull(env) : 1000000;
+    }
+
+    // Adds the fields and counters of a pose to the samples of its rule.
+    static void addSample(ruleSamples& rule, const PoseGenerator::perturbParams& params,
+                          const Augmenter::Pose& pose)
+    {
+        float values[3] = {pose.shift, pose.rotation, pose.forward};
+        for (int f = 0; f < 3; ++f)
+        {
+            rule.fields[f].push_back(values[f]);
+        }
+        for (const auto& sensorName : sensorNames)
+        {
+            rule.fields[PoseStatistics::SensorYaw].push_back(pose.sensor_yaw.at(sensorName));
+            rule.fields[PoseStatistics::SensorPitch].push_back(pose.sensor_pitch.at(sensorName));
+            rule.fields[PoseStatistics::SensorRoll].push_back(pose.sensor_roll.at(sensorName));
+        }
+        ++rule.numPoses;
+        rule.numFlipped += pose.flip ? 1 : 0;
+        rule.numOutOfBounds += (std::abs(pose.shift) > params.shift.max ||
+                                std::abs(pose.rotation) > params.rotation.max ||
+                                std::abs(pose.forward) > params.forward.max)
+                                   ? 1
+                                   : 0;
+    }
+
+    // Runs the goodness-of-fit tests on every field of every rule.
+    static void expectFieldDistributions(std::vector<ruleSamples>& ruleValues)
+    {
+        for (uint32_t r = 0; r < configRules.size(); ++r)
+        {
+            for (int f = 0; f < kNumFields; ++f)
+            {
+                std::vector<float>& values = ruleValues[r].fields[f];
+                const PoseGenerator::randParams& params = fieldParams(configRules[r].second, f);
+                const char* name = PoseStatistics::fieldName(static_cast<PoseStatistics::Field>(f));
+                if (values.empty())
+                {
+                    continue;
+                }
+                if (isDegenerate(params))
+                {
+                    // A zero limit or deviation must produce exactly zero.
+                    for (float value : values)
+                    {
+                        ASSERT_EQ(value, 0.f) << "rule " << r << " " << name;
+                    }
+                    continue;
+                }
+
+                // Shift and rotation are negated by flipping; all distributions are symmetric,
+                // so flipped poses follow the same distribution.
+                uint32_t numBins = 0;
+                const double chi2 = chiSquareStatistic(values, params, numBins);
+                EXPECT_LE(chi2, chiSquareCritical(numBins))
+                    << "rule " << r << " " << name << ": chi-square over " << numBins << " bins";
+
+                const double d = ksStatistic(values, params);
+                EXPECT_LE(d, ksCritical(values.size(), kAlpha))
+                    << "rule " << r << " " << name << ": KS over " << values.size() << " samples";
+            }
+        }
+    }
+
+    static void SetUpTestSuite()
+    {
+        configRules = {
+            {"road_type=highway user_label=stable",
+             {{"gaussian", 0.5, 0.34}, {"gaussian", 4.0, 1.0}, {"gaussian", 0.8, 0.5},
+              {"gaussian", 5.0, 3.0}, {"gaussian", 6.0, 3.0}, {"gaussian", 0, 0}, true}},
+            {"road_type=local user_label=stable",
+             {{"gaussian", 0.5, 0.34}, {"uniform", 8.0, 1.0}, {"uniform", 0.8, 0.5},
+              {"uniform", 5.0, 3.0}, {"gaussian", 6.0, 3.0}, {"gaussian", 2.0, 1.5}, false}},
+        };
+        sensorNames = {"center", "pilot", "pilotPinhole"};
+
+        const std::string labelFileName = TestsDataPath::get() + "FILENAME.csv"; // YOUR FILE NAME
+
+        // Expected rule of every frame, resolved independently of PoseGenerator.
+        projMetaData::projMetaTrace trace(labelFileName);
+        const uint32_t numFrames = trace.getNumDatapoints();
+        frameRules.assign(numFrames, -1);
+        for (uint32_t i = 0; i < numFrames; ++i)
+        {
+            for (uint32_t r = 0; r < configRules.size() && frameRules[i] < 0; ++r)
+            {
+                if (trace.doLabelsMatch(i, projMetaData::stringMapFromSplitString(configRules[r].first)))
+                {
+                    frameRules[i] = r;
+                }
+            }
+        }
+
+        const uint64_t posesPerBatch = static_cast<uint64_t>(numFrames) * kBatchUseCount;
+        const uint32_t numBatches = std::max<uint64_t>(1, targetPoses() / posesPerBatch);
+        const uint32_t numThreads =
+            std::min(std::max(1u, std::thread::hardware_concurrency()), numBatches);
+
+        std::vector<std::vector<ruleSamples>> perThread(numThreads,
+                                                        std::vector<ruleSamples>(configRules.size()));
+        std::vector<std::thread> workers;
+        for (uint32_t t = 0; t < numThreads; ++t)
+        {
+            workers.emplace_back([&, t]() {
+                // One call per thread with all of its batches folded into the use counts.
+                PoseGenerator generator(configRules, sensorNames, t + 1);
+                const uint32_t threadBatches = (numBatches - t + numThreads - 1) / numThreads;
+                std::vector<uint32_t> vecUseCounts(numFrames, threadBatches * kBatchUseCount);
+                std::vector<ruleSamples>& out = perThread[t];
+                auto framePoses = generator.generatePoses4vecFrames(vecUseCounts, labelFileName);
+                for (uint32_t i = 0; i < numFrames; ++i)
+                {
+                    for (const auto& pose : framePoses[i])
+                    {
+                        addSample(out[frameRules[i]], configRules[frameRules[i]].second, pose);
+                    }
+                }
+            });
+        }
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+
+        // Merge per-thread samples.
+        samples.assign(configRules.size(), ruleSamples());
+        expectedPoses.assign(configRules.size(), 0);
+        for (const auto& threadSamples : perThread)
+        {
+            for (uint32_t r = 0; r < configRules.size(); ++r)
+            {
+                for (int f = 0; f < kNumFields; ++f)
+                {
+                    samples[r].fields[f].insert(samples[r].fields[f].end(),
+                                                threadSamples[r].fields[f].begin(),
+                                                threadSamples[r].fields[f].end());
+                }
+                samples[r].numPoses += threadSamples[r].numPoses;
+                samples[r].numFlipped += threadSamples[r].numFlipped;
+                samples[r].numOutOfBounds += threadSamples[r].numOutOfBounds;
+            }
+        }
+        for (uint32_t i = 0; i < numFrames; ++i)
+        {
+            if (frameRules[i] >= 0)
+            {
+                expectedPoses[frameRules[i]] += static_cast<uint64_t>(numBatches) * kBatchUseCount;
+            }
+        }
+    }
+
+    static void TearDownTestSuite()
+    {
+        samples.clear();
+    }
+};
+
+std::vector<std::pair<std::string, PoseGenerator::perturbParams>> PoseDistributionTest::configRules;
+std::vector<std::string> PoseDistributionTest::sensorNames;
+std::vector<PoseDistributionTest::ruleSamples> PoseDistributionTest::samples;
+std::vector<uint64_t> PoseDistributionTest::expectedPoses;
+std::vector<int> PoseDistributionTest::frameRules;
+
+TEST_F(PoseDistributionTest, TestRuleAssignment_L0)
+{
+    for (uint32_t r = 0; r < configRules.size(); ++r)
+    {
+        // We expect every frame to receive its poses from the first matching rule only.
+        ASSERT_EQ(samples[r].numPoses, expectedPoses[r]) << "rule " << r;
+        ASSERT_EQ(samples[r].numOutOfBounds, 0u) << "rule " << r;
+    }
+}
+
+TEST_F(PoseDistributionTest, TestFlipRatio_L0)
+{
+    for (uint32_t r = 0; r < configRules.size(); ++r)
+    {
+        // Flipping rules flip every other pose of a frame, others never flip.
+        const uint64_t expectedFlipped = configRules[r].second.flip ? samples[r].numPoses / 2 : 0;
+        ASSERT_EQ(samples[r].numFlipped, expectedFlipped) << "rule " << r;
+    }
+}
+
+TEST_F(PoseDistributionTest, TestFieldDistributions_L0)
+{
+    expectFieldDistributions(samples);
+}
+
+TEST_F(PoseDistributionTest, TestEnsembleDistributions_L0)
+{
+    // Ensemble lanes draw from their own streams (xoshiro256+ and Box-Muller), so their
+    // pooled values must pass the same goodness-of-fit tests.
+    const std::string labelFileName = TestsDataPath::get() + "FILENAME.csv"; // YOUR FILE NAME
+    projMetaData::projMetaTrace trace(labelFileName);
+    const uint32_t numFrames = trace.getNumDatapoints();
+    std::vector<uint64_t> seeds(16);
+    std::iota(seeds.begin(), seeds.end(), 1);
+    const uint64_t posesPerSet = static_cast<uint64_t>(numFrames) * kBatchUseCount;
+    const uint32_t useCount =
+        std::max<uint64_t>(1, targetPoses() / (posesPerSet * seeds.size())) * kBatchUseCount;
+    PoseGenerator generator(configRules, sensorNames, 1);
+    PoseEnsemble ensemble =
+        generator.generateEnsemble(std::vector<uint32_t>(numFrames, useCount), labelFileName, seeds);
+
+    std::vector<ruleSamples> ensembleSamples(configRules.size());
+    Augmenter::Pose pose = {};
+    for (size_t s = 0; s < ensemble.size(); ++s)
+    {
+        for (size_t i = 0; i < ensemble.getNumPoses(); ++i)
+        {
+            ensemble.getPose(s, i, pose);
+            const int rule = frameRules[pose.srcFrame];
+            addSample(ensembleSamples[rule], configRules[rule].second, pose);
+        }
+    }
+    for (uint32_t r = 0; r < configRules.size(); ++r)
+    {
+        const uint64_t expectedFlipped = configRules[r].second.flip ? ensembleSamples[r].numPoses / 2 : 0;
+        ASSERT_EQ(ensembleSamples[r].numFlipped, expectedFlipped) << "rule " << r;
+        ASSERT_EQ(ensembleSamples[r].numOutOfBounds, 0u) << "rule " << r;
+    }
+    expectFieldDistributions(ensembleSamples);
+}
+
+} // namespace
@@ -4,12 +4,20 @@
 *
 ******************************************************************************/
 
+#include <algorithm>
+#include <array>
 #include <iostream>
 #include <fstream>
+#include <map>
 #include <cmath>
+#include <filesystem>
 #include <memory>
+#include <numeric>
+
+#include <zlib.h>
 
 #include "gtest/gtest.h"
+#include "batchPacker.hpp"
 #include "poseGenerator.hpp"
 #include <common/TestsDataPath.hpp>
 
@@ -134,4 +142,815 @@ TEST_F(PoseGeneratorTest, TestGeneratePoses4vecFrame_L0)
     }
 }
 
+TEST_F(PoseGeneratorTest, TestPoseStatistics_L0)
+{
+    std::string labelFileName = TestsDataPath::get() + "FILENAME.csv"; // YOUR FILE NAME
+
+    projMetaData::projMetaTrace trace(labelFileName);
+    std::vector<uint32_t> vecUseCounts(trace.getNumDatapoints(), 4);
+
+    // Statistics are off by default.
+    ASSERT_EQ(testObject->getStatistics(), nullptr);
+    testObject->enableStatistics(true);
+    testObject->generatePoses4vecFrames(vecUseCounts, labelFileName);
+
+    const PoseStatistics* stats = testObject->getStatistics();
+    ASSERT_NE(stats, nullptr);
+    ASSERT_EQ(stats->numRules(), configRules.size());
+
+    // We expect every pose to be counted once, under the rule it was generated from.
+    ASSERT_EQ(stats->numPoses(0) + stats->numPoses(1), 4u * trace.getNumDatapoints());
+    ASSERT_EQ(stats->numPoses(0), 4u * 2);
+    // Rule 0 flips every other pose, rule 1 never flips.
+    ASSERT_DOUBLE_EQ(stats->flipRatio(0), 0.5);
+    ASSERT_DOUBLE_EQ(stats->flipRatio(1), 0.0);
+
+    for (uint32_t rule = 0; rule < configRules.size(); ++rule)
+    {
+        const PoseGenerator::perturbParams& params = configRules[rule].second;
+        PoseStatistics::fieldSummary shift = stats->summary(rule, PoseStatistics::Shift);
+        PoseStatistics::fieldSummary yaw = stats->summary(rule, PoseStatistics::SensorYaw);
+
+        // Sensor angles are pooled over all sensors.
+        ASSERT_EQ(yaw.count, stats->numPoses(rule) * testSensorNames.size());
+        ASSERT_TRUE(valueInBound(shift.min, params.shift.max));
+        ASSERT_TRUE(valueInBound(shift.max, params.shift.max));
+        ASSERT_LE(shift.variance, params.shift.max * params.shift.max);
+
+        uint64_t binned = 0;
+        for (uint64_t bin : shift.histogram)
+        {
+            binned += bin;
+        }
+        ASSERT_EQ(binned, shift.count);
+    }
+
+    // A report resets the summaries for the next epoch.
+    std::string report = testObject->reportStatistics(0);
+    ASSERT_NE(report.find("epoch=0 rule=0"), std::string::npos);
+    ASSERT_EQ(stats->numPoses(0), 0u);
+}
+
+TEST_F(PoseGeneratorTest, TestRuleCoverage_L0)
+{
+    std::string labelFileName = TestsDataPath::get() + "FILENAME.csv"; // YOUR FILE NAME
+
+    projMetaData::projMetaTrace trace(labelFileName);
+    const uint32_t numFrames = trace.getNumDatapoints();
+    std::vector<uint32_t> vecUseCounts(numFrames, 2);
+
+    // Only the highway rule: every frame from 2 on is uncovered.
+    PoseGenerator highwayOnly({configRules[0]}, testSensorNames, 1);
+    std::vector<RuleSet::frameRange> uncovered = highwayOnly.findUncoveredFrames(vecUseCounts, labelFileName);
+    ASSERT_EQ(uncovered.size(), 1u);
+    ASSERT_EQ(uncovered[0].first, 2u);
+    ASSERT_EQ(uncovered[0].last, numFrames - 1);
+    ASSERT_THROW(highwayOnly.generatePoses4vecFrames(vecUseCounts, labelFileName), std::runtime_error);
+
+    // Frames that need no poses do not need a rule.
+    std::vector<uint32_t> highwayCounts(numFrames, 0);
+    highwayCounts[0] = highwayCounts[1] = 2;
+    ASSERT_TRUE(highwayOnly.findUncoveredFrames(highwayCounts, labelFileName).empty());
+    ASSERT_NO_THROW(highwayOnly.generatePoses4vecFrames(highwayCounts, labelFileName));
+
+    // With a fallback rule, uncovered frames use its parameters.
+    highwayOnly.setFallbackRule(perturbParams2);
+    std::vector<std::vector<Augmenter::Pose>> framePoses =
+        highwayOnly.generatePoses4vecFrames(vecUseCounts, labelFileName);
+    ASSERT_EQ(framePoses.size(), numFrames);
+    ASSERT_TRUE(framePoses[0][1].flip);
+    for (uint32_t i = 2; i < numFrames; ++i)
+    {
+        ASSERT_EQ(framePoses[i].size(), 2u);
+        ASSERT_FALSE(framePoses[i][1].flip);
+        ASSERT_TRUE(valueInBound(framePoses[i][0].rotation, perturbParams2.rotation.max));
+    }
+}
+
+TEST_F(PoseGeneratorTest, TestTraceLengthMismatch_L0)
+{
+    std::string labelFileName = TestsDataPath::get() + "FILENAME.csv"; // YOUR FILE NAME
+
+    projMetaData::projMetaTrace trace(labelFileName);
+    const uint32_t numFrames = trace.getNumDatapoints();
+    ASSERT_EQ(LabelTable::countRows(labelFileName), numFrames);
+
+    // A use count vector of the wrong length is rejected before labels are loaded.
+    PoseGenerator poseGenerator(configRules, testSensorNames, 1);
+    std::vector<uint32_t> vecUseCounts(numFrames + 1, 1);
+    ASSERT_THROW(poseGenerator.generatePoses4vecFrames(vecUseCounts, labelFileName), std::invalid_argument);
+    ASSERT_THROW(poseGenerator.generateShuffledPoses(vecUseCounts, labelFileName), std::invalid_argument);
+
+    // A compressed trace is checked after its single streaming load.
+    std::ifstream in(labelFileName, std::ios::binary);
+    const std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    const std::string gzipFileName = (std::filesystem::temp_directory_path() / "lengthMismatch.csv.gz").string();
+    gzFile out = gzopen(gzipFileName.c_str(), "wb");
+    ASSERT_NE(out, nullptr);
+    ASSERT_EQ(gzwrite(out, content.data(), content.size()), static_cast<int>(content.size()));
+    gzclose(out);
+    ASSERT_THROW(poseGenerator.generatePoses4vecFrames(vecUseCounts, gzipFileName), std::invalid_argument);
+    vecUseCounts.pop_back();
+    PoseGenerator plainGenerator(configRules, testSensorNames, 2);
+    PoseGenerator gzipGenerator(configRules, testSensorNames, 2);
+    auto plainPoses = plainGenerator.generateShuffledPoses(vecUseCounts, labelFileName);
+    auto gzipPoses  = gzipGenerator.generateShuffledPoses(vecUseCounts, gzipFileName);
+    std::filesystem::remove(gzipFileName);
+    ASSERT_EQ(gzipPoses.size(), plainPoses.size());
+    for (size_t i = 0; i < plainPoses.size(); ++i)
+    {
+        ASSERT_EQ(gzipPoses[i].srcFrame, plainPoses[i].srcFrame) << "pose " << i;
+        ASSERT_EQ(gzipPoses[i].shift, plainPoses[i].shift) << "pose " << i;
+    }
+}
+
+TEST_F(PoseGeneratorTest, TestFrameGroupDelivery_L0)
+{
+    std::string labelFileName = TestsDataPath::get() + "FILENAME.csv"; // YOUR FILE NAME
+
+    projMetaData::projMetaTrace trace(labelFileName);
+    const uint32_t numFrames = trace.getNumDatapoints();
+    std::vector<uint32_t> vecUseCounts(numFrames, 0);
+    for (uint32_t i = 0; i < numFrames; i += 3)
+    {
+        vecUseCounts[i] = 1 + i % 8;
+    }
+    const uint64_t numPoses  = std::accumulate(vecUseCounts.begin(), vecUseCounts.end(), uint64_t(0));
+    const uint64_t numGroups = (numFrames + 2) / 3;
+
+    // Shuffled poses of a frame are scattered: most poses cost a decode.
+    std::vector<Augmenter::Pose> poses = testObject->generateShuffledPoses(vecUseCounts, labelFileName);
+    ASSERT_EQ(poses.size(), numPoses);
+    ASSERT_EQ(testObject->getDeliveryStatistics().numPoses, numPoses);
+    ASSERT_EQ(testObject->getDeliveryStatistics().numFrames, numGroups);
+    ASSERT_GT(testObject->getDeliveryStatistics().numDecodes, numGroups);
+
+    // Frame groups: every frame is decoded once, and its poses come back to back.
+    testObject->setDeliveryMode(PoseGenerator::ShuffleFrameGroups);
+    poses = testObject->generateShuffledPoses(vecUseCounts, labelFileName);
+    ASSERT_EQ(poses.size(), numPoses);
+    ASSERT_EQ(testObject->getDeliveryStatistics().numDecodes, numGroups);
+    ASSERT_FALSE(poses[0].flip);
+
+    std::vector<uint32_t> posesSeen(numFrames, 0);
+    bool shuffled = false;
+    for (size_t i = 0; i < poses.size(); ++i)
+    {
+        const bool groupStart = i == 0 || poses[i].srcFrame != poses[i - 1].srcFrame;
+        if (groupStart)
+        {
+            // A frame appears in one group only, starting with an unflipped pose.
+            ASSERT_EQ(posesSeen[poses[i].srcFrame], 0u);
+            ASSERT_FALSE(poses[i].flip);
+            shuffled |= i > 0 && poses[i].srcFrame < poses[i - 1].srcFrame;
+        }
+        ++posesSeen[poses[i].srcFrame];
+    }
+    ASSERT_EQ(posesSeen, vecUseCounts);
+    ASSERT_TRUE(shuffled);
+}
+
+TEST_F(PoseGeneratorTest, TestNextUse_L0)
+{
+    std::vector<Augmenter::Pose> order(6);
+    const uint32_t frames[] = {4, 1, 4, 2, 1, 4};
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        order[i].srcFrame = frames[i];
+    }
+    const uint32_t kNo = PoseGenerator::kNoReuse;
+    ASSERT_EQ(PoseGenerator::computeNextUse(order), (std::vector<uint32_t>{2, 4, 5, kNo, kNo, kNo}));
+    ASSERT_TRUE(PoseGenerator::computeNextUse({}).empty());
+
+    // Hints returned with a shuffled order point at the next pose of the same frame.
+    std::string labelFileName = TestsDataPath::get() + "FILENAME.csv"; // YOUR FILE NAME
+    projMetaData::projMetaTrace trace(labelFileName);
+    std::vector<uint32_t> vecUseCounts(trace.getNumDatapoints(), 3);
+    std::vector<uint32_t> nextUse;
+    std::vector<Augmenter::Pose> poses = testObject->generateShuffledPoses(vecUseCounts, labelFileName, nextUse);
+    ASSERT_EQ(nextUse.size(), poses.size());
+    std::vector<uint32_t> lastUse(vecUseCounts.size(), kNo);
+    for (size_t i = 0; i < poses.size(); ++i)
+    {
+        if (lastUse[poses[i].srcFrame] != kNo)
+        {
+            ASSERT_EQ(nextUse[lastUse[poses[i].srcFrame]], i);
+        }
+        lastUse[poses[i].srcFrame] = i;
+    }
+    for (uint32_t last : lastUse)
+    {
+        ASSERT_EQ(nextUse[last], kNo);
+    }
+}
+
+TEST_F(PoseGeneratorTest, TestGopBlockDelivery_L0)
+{
+    // Decode cost model on GOPs of 4 frames: frames 0-3 and 4-7.
+    std::vector<uint32_t> keyframeOffsets = {0, 1, 2, 3, 0, 1, 2, 3};
+    std::vector<Augmenter::Pose> order(5);
+    const uint32_t frames[] = {2, 2, 3, 1, 6};
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        order[i].srcFrame = frames[i];
+    }
+    // Seek to 0 and decode 0-2, same frame, forward to 3, seek for 0-1, seek for 4-6.
+    ASSERT_EQ(PoseGenerator::computeDecodeCost(order, keyframeOffsets), 3u + 0u + 1u + 2u + 3u);
+
+    std::string labelFileName = TestsDataPath::get() + "FILENAME.csv"; // YOUR FILE NAME
+    projMetaData::projMetaTrace trace(labelFileName);
+    const uint32_t numFrames = trace.getNumDatapoints();
+    std::vector<uint32_t> vecUseCounts(numFrames, 2);
+    keyframeOffsets.resize(numFrames);
+    for (uint32_t i = 0; i < numFrames; ++i)
+    {
+        keyframeOffsets[i] = i % 30;
+    }
+    ASSERT_THROW(testObject->setGopIndex(std::vector<uint32_t>{1, 0}), std::invalid_argument);
+    testObject->setDeliveryMode(PoseGenerator::ShuffleGopBlocks, 8);
+    ASSERT_THROW(testObject->generateShuffledPoses(vecUseCounts, labelFileName), std::invalid_argument);
+
+    // The GOP index can be loaded from a file.
+    const std::string gopFileName = (std::filesystem::temp_directory_path() / "gopIndex.txt").string();
+    {
+        std::ofstream out(gopFileName);
+        out << "# keyframe offset per frame\n";
+        for (uint32_t offset : keyframeOffsets)
+        {
+            out << offset << "\n";
+        }
+    }
+    testObject->setGopIndex(gopFileName);
+    std::filesystem::remove(gopFileName);
+
+    std::vector<Augmenter::Pose> poses = testObject->generateShuffledPoses(vecUseCounts, labelFileName);
+    ASSERT_EQ(poses.size(), 2u * numFrames);
+    ASSERT_FALSE(poses[0].flip);
+    const uint64_t blockCost = testObject->getDeliveryStatistics().decodeCost;
+    ASSERT_EQ(blockCost, PoseGenerator::computeDecodeCost(poses, keyframeOffsets));
+
+    // Every frame is delivered with all its poses, in an order that is not sequential.
+    std::vector<uint32_t> posesSeen(numFrames, 0);
+    uint32_t descents = 0;
+    for (size_t i = 0; i < poses.size(); ++i)
+    {
+        ++posesSeen[poses[i].srcFrame];
+        descents += i > 0 && poses[i].srcFrame < poses[i - 1].srcFrame;
+    }
+    ASSERT_EQ(posesSeen, vecUseCounts);
+    ASSERT_GT(descents, 2u);
+
+    // GOP blocks cost less to decode than shuffled frames and shuffled poses.
+    testObject->setDeliveryMode(PoseGenerator::ShuffleFrameGroups);
+    testObject->generateShuffledPoses(vecUseCounts, labelFileName);
+    const uint64_t groupCost = testObject->getDeliveryStatistics().decodeCost;
+    testObject->setDeliveryMode(PoseGenerator::ShufflePoses);
+    testObject->generateShuffledPoses(vecUseCounts, labelFileName);
+    const uint64_t poseCost = testObject->getDeliveryStatistics().decodeCost;
+    ASSERT_LT(blockCost, groupCost);
+    ASSERT_LT(groupCost, poseCost);
+}
+
+TEST_F(PoseGeneratorTest, TestSensorRotations_L0)
+{
+    // Batched sines and cosines match the library over several turns.
+    std::vector<float> degrees;
+    for (float angle = -720.0f; angle <= 720.0f; angle += 0.37f)
+    {
+        degrees.push_back(angle);
+    }
+    std::vector<float> sines(degrees.size());
+    std::vector<float> cosines(degrees.size());
+    SensorRotations::sinCosDegrees(degrees.data(), sines.data(), cosines.data(), degrees.size());
+    for (size_t i = 0; i < degrees.size(); ++i)
+    {
+        const double radians = degrees[i] * M_PI / 180.0;
+        ASSERT_NEAR(sines[i], std::sin(radians), 2e-6) << degrees[i];
+        ASSERT_NEAR(cosines[i], std::cos(radians), 2e-6) << degrees[i];
+    }
+
+    std::string labelFileName = TestsDataPath::get() + "FILENAME.csv"; // YOUR FILE NAME
+    projMetaData::projMetaTrace trace(labelFileName);
+    std::vector<uint32_t> vecUseCounts(trace.getNumDatapoints(), 2);
+    ASSERT_EQ(testObject->getSensorRotations(), nullptr);
+    testObject->enableSensorRotations(true);
+    std::vector<Augmenter::Pose> poses = testObject->generateShuffledPoses(vecUseCounts, labelFileName);
+
+    const SensorRotations* rotations = testObject->getSensorRotations();
+    ASSERT_NE(rotations, nullptr);
+    ASSERT_EQ(rotations->getNumPoses(), poses.size());
+    ASSERT_EQ(rotations->getNumSensors(), testSensorNames.size());
+    for (uint32_t row = 0; row < 3; ++row)
+    {
+        for (uint32_t col = 0; col < 3; ++col)
+        {
+            ASSERT_EQ(reinterpret_cast<uintptr_t>(rotations->getElement(row, col)) % SensorRotations::kAlignment, 0u);
+        }
+    }
+
+    // Every matrix is Rz(yaw) * Ry(pitch) * Rx(roll) of the pose's sensor angles in degrees.
+    for (uint32_t p = 0; p < poses.size(); ++p)
+    {
+        for (uint32_t s = 0; s < testSensorNames.size(); ++s)
+        {
+            const double y = poses[p].sensor_yaw[testSensorNames[s]] * M_PI / 180.0;
+            const double t = poses[p].sensor_pitch[testSensorNames[s]] * M_PI / 180.0;
+            const double r = poses[p].sensor_roll[testSensorNames[s]] * M_PI / 180.0;
+            const double expected[9] = {
+                std::cos(y) * std::cos(t),
+                std::cos(y) * std::sin(t) * std::sin(r) - std::sin(y) * std::cos(r),
+                std::cos(y) * std::sin(t) * std::cos(r) + std::sin(y) * std::sin(r),
+                std::sin(y) * std::cos(t),
+                std::sin(y) * std::sin(t) * std::sin(r) + std::cos(y) * std::cos(r),
+                std::sin(y) * std::sin(t) * std::cos(r) - std::cos(y) * std::sin(r),
+                -std::sin(t),
+                std::cos(t) * std::sin(r),
+                std::cos(t) * std::cos(r),
+            };
+            const std::array<float, 9> matrix = rotations->getMatrix(p, s);
+            for (int e = 0; e < 9; ++e)
+            {
+                ASSERT_NEAR(matrix[e], expected[e], 1e-5) << "pose " << p << " sensor " << s;
+                ASSERT_EQ(rotations->getElement(e / 3, e % 3)[p * testSensorNames.size() + s], matrix[e]);
+            }
+        }
+    }
+
+    // Disabling drops the output.
+    testObject->enableSensorRotations(false);
+    ASSERT_EQ(testObject->getSensorRotations(), nullptr);
+}
+
+TEST_F(PoseGeneratorTest, TestLatticeMode_L0)
+{
+    std::string labelFileName = TestsDataPath::get() + "FILENAME.csv"; // YOUR FILE NAME
+    projMetaData::projMetaTrace trace(labelFileName);
+    std::vector<uint32_t> vecUseCounts(trace.getNumDatapoints(), 50);
+    const uint32_t kSteps = 4;
+    testObject->setLatticeMode(kSteps);
+    std::vector<Augmenter::Pose> poses = testObject->generateShuffledPoses(vecUseCounts, labelFileName);
+    const std::vector<uint64_t>& keys = testObject->getLatticeKeys();
+    ASSERT_EQ(keys.size(), poses.size());
+
+    // Every value is a grid point of its rule's bound (frames 0 and 1 are highway frames).
+    auto onGrid = [&](float value, const PoseGenerator::randParams& params) {
+        if (params.max == 0)
+        {
+            return value == 0.0f;
+        }
+        const double k = value / (params.max / kSteps);
+        return valueInBound(value, static_cast<float>(params.max)) && std::abs(k - std::round(k)) < 1e-4;
+    };
+    uint32_t numLocal = 0;
+    uint32_t numTopRotation = 0;
+    uint32_t numZeroShift = 0;
+    std::map<uint64_t, const Augmenter::Pose*> cells;
+    for (size_t i = 0; i < poses.size(); ++i)
+    {
+        const Augmenter::Pose& pose = poses[i];
+        const PoseGenerator::perturbParams& params = pose.srcFrame < 2 ? perturbParams1 : perturbParams2;
+        ASSERT_TRUE(onGrid(pose.shift, params.shift)) << pose.shift;
+        ASSERT_TRUE(onGrid(pose.rotation, params.rotation)) << pose.rotation;
+        ASSERT_TRUE(onGrid(pose.forward, params.forward)) << pose.forward;
+        for (const auto& sensorName : testSensorNames)
+        {
+            ASSERT_TRUE(onGrid(pose.sensor_yaw.at(sensorName), params.sensor_yaw));
+            ASSERT_TRUE(onGrid(pose.sensor_pitch.at(sensorName), params.sensor_pitch));
+            ASSERT_TRUE(onGrid(pose.sensor_roll.at(sensorName), params.sensor_roll));
+        }
+        if (pose.srcFrame >= 2)
+        {
+            ++numLocal;
+            numTopRotation += pose.rotation == static_cast<float>(params.rotation.max);
+            numZeroShift += pose.shift == 0.0f;
+        }
+
+        // Keys only depend on the pose, and equal keys mean equal poses.
+        ASSERT_EQ(keys[i], PoseGenerator::computeLatticeKey(pose));
+        auto cell = cells.emplace(keys[i], &pose);
+        if (!cell.second)
+        {
+            const Augmenter::Pose& other = *cell.first->second;
+            ASSERT_EQ(pose.shift, other.shift);
+            ASSERT_EQ(pose.rotation, other.rotation);
+            ASSERT_EQ(pose.forward, other.forward);
+            ASSERT_EQ(pose.flip, other.flip);
+            ASSERT_EQ(pose.sensor_yaw, other.sensor_yaw);
+            ASSERT_EQ(pose.sensor_pitch, other.sensor_pitch);
+            ASSERT_EQ(pose.sensor_roll, other.sensor_roll);
+        }
+    }
+
+    // Grid points keep the probability of their cells: the top uniform point owns half a
+    // cell, the zero point of the truncated Gaussian owns |x| < step / 2.
+    EXPECT_NEAR(static_cast<double>(numTopRotation) / numLocal, 1.0 / (4 * kSteps), 0.01);
+    const double shiftScale = perturbParams2.shift.stdDev * std::sqrt(2.0);
+    const double zeroShift  = std::erf(perturbParams2.shift.max / (2 * kSteps) / shiftScale) /
+                             std::erf(perturbParams2.shift.max / shiftScale);
+    EXPECT_NEAR(static_cast<double>(numZeroShift) / numLocal, zeroShift, 0.02);
+
+    // A flipped pose negates zeros, which must not change its key.
+    Augmenter::Pose zero = {};
+    Augmenter::Pose negated = zero;
+    negated.shift = -0.0f;
+    ASSERT_EQ(PoseGenerator::computeLatticeKey(zero), PoseGenerator::computeLatticeKey(negated));
+
+    // Disabling lattice mode drops the keys.
+    testObject->setLatticeMode(0);
+    testObject->generateShuffledPoses(vecUseCounts, labelFileName);
+    ASSERT_TRUE(testObject->getLatticeKeys().empty());
+}
+
+TEST_F(PoseGeneratorTest, TestValidityModel_L0)
+{
+    // 1600x800 crop centered in a 1920x1080 image: about 5 degrees of yaw margin.
+    const PoseValidity::sensorModel center = {1000, 1000, 960, 540, 1600, 800, 0, 0, 1920, 1080, 20};
+    PoseValidity validity;
+    ASSERT_TRUE(validity.empty());
+    validity.setSensorModel("center", center);
+    PoseValidity::sensorModel empty = center;
+    empty.maxX = empty.minX;
+    ASSERT_THROW(validity.setSensorModel("pilot", empty), std::invalid_argument);
+
+    Augmenter::Pose pose = {};
+    ASSERT_TRUE(validity.isValid(pose));
+    pose.rotation = 4.0f;
+    ASSERT_TRUE(validity.isValid(pose));
+    pose.sensor_yaw["center"] = 2.0f;
+    ASSERT_FALSE(validity.isValid(pose));
+    pose.sensor_yaw["pilot"] = -2.0f; // not modeled
+    pose.sensor_yaw["center"] = 0.0f;
+    ASSERT_TRUE(validity.isValid(pose));
+    pose = {};
+    pose.shift = 3.0f; // 150 of 160 pixels at 20 m
+    ASSERT_TRUE(validity.isValid(pose));
+    pose.shift = -3.4f;
+    ASSERT_FALSE(validity.isValid(pose));
+    pose = {};
+    pose.forward = -4.0f; // moving back widens the view of the crop
+    ASSERT_FALSE(validity.isValid(pose));
+    pose.forward = 4.0f;
+    ASSERT_TRUE(validity.isValid(pose));
+
+    // Generated poses are all valid; local frames reach up to 8 + 5 degrees of yaw, so some
+    // are resampled.
+    std::string labelFileName = TestsDataPath::get() + "FILENAME.csv"; // YOUR FILE NAME
+    projMetaData::projMetaTrace trace(labelFileName);
+    std::vector<uint32_t> vecUseCounts(trace.getNumDatapoints(), 5);
+    testObject->setValidityModel(validity);
+    std::vector<Augmenter::Pose> poses = testObject->generateShuffledPoses(vecUseCounts, labelFileName);
+    ASSERT_EQ(poses.size(), 5 * vecUseCounts.size());
+    ASSERT_GT(testObject->getNumRejectedPoses(), 0u);
+    for (const Augmenter::Pose& generated : poses)
+    {
+        ASSERT_TRUE(validity.isValid(generated));
+    }
+
+    // Poses are checked as delivered, so flipped poses stay valid under a valid region that
+    // is not mirror-symmetric about the crop center, even where their mirror images are not.
+    PoseValidity asymmetric;
+    PoseValidity::sensorModel leftMargin = center;
+    leftMargin.minX = 100;
+    asymmetric.setSensorModel("center", leftMargin);
+    std::vector<std::pair<std::string, PoseGenerator::perturbParams>> flippingRules = configRules;
+    for (auto& rule : flippingRules)
+    {
+        rule.second.flip = true;
+    }
+    PoseGenerator flipping(flippingRules, testSensorNames, 1);
+    flipping.setValidityModel(asymmetric);
+    poses = flipping.generateShuffledPoses(vecUseCounts, labelFileName);
+    uint32_t invalidMirrors = 0;
+    for (const Augmenter::Pose& generated : poses)
+    {
+        ASSERT_TRUE(asymmetric.isValid(generated));
+        Augmenter::Pose mirror = generated;
+        mirror.shift *= -1;
+        mirror.rotation *= -1;
+        invalidMirrors += generated.flip && !asymmetric.isValid(mirror);
+    }
+    ASSERT_GT(invalidMirrors, 0u);
+
+    // A crop larger than the valid region can never be satisfied.
+    PoseValidity impossible;
+    PoseValidity::sensorModel tooLarge = center;
+    tooLarge.cropWidth = 2000;
+    impossible.setSensorModel("center", tooLarge);
+    testObject->setValidityModel(impossible);
+    ASSERT_THROW(testObject->generateShuffledPoses(vecUseCounts, labelFileName), std::runtime_error);
+
+    // An empty model disables the check.
+    testObject->setValidityModel(PoseValidity());
+    ASSERT_NO_THROW(testObject->generateShuffledPoses(vecUseCounts, labelFileName));
+}
+
+TEST_F(PoseGeneratorTest, TestBatchPacking_L0)
+{
+    std::string labelFileName = TestsDataPath::get() + "FILENAME.csv"; // YOUR FILE NAME
+    projMetaData::projMetaTrace trace(labelFileName);
+    std::vector<uint32_t> vecUseCounts(trace.getNumDatapoints(), 3);
+    std::vector<Augmenter::Pose> poses = testObject->generateShuffledPoses(vecUseCounts, labelFileName);
+
+    // Flipping dominates the cost; only highway poses are flipped, so few poses are expensive.
+    BatchPacker packer({1.0, 20.0, {{"center", 2.0}, {"pilot", 1.0}}});
+    Augmenter::Pose plain = poses[0];
+    plain.flip = false;
+    Augmenter::Pose flipped = plain;
+    flipped.flip = true;
+    ASSERT_DOUBLE_EQ(packer.estimateCost(plain), 4.0);
+    ASSERT_DOUBLE_EQ(packer.estimateCost(flipped), 24.0);
+
+    // Measured costs rescale later estimates of their kind only.
+    packer.recordCost(flipped, 48.0);
+    ASSERT_DOUBLE_EQ(packer.estimateCost(flipped), 48.0);
+    ASSERT_DOUBLE_EQ(packer.estimateCost(plain), 4.0);
+    packer.recordCost(flipped, 24.0);
+    ASSERT_LT(packer.estimateCost(flipped), 48.0);
+    ASSERT_GT(packer.estimateCost(flipped), 24.0);
+
+    const std::vector<double> costs = packer.estimateCosts(poses);
+    const double totalCost          = std::accumulate(costs.begin(), costs.end(), 0.0);
+    const double maxCost            = *std::max_element(costs.begin(), costs.end());
+    auto checkPacking = [&](const BatchPacker::packing& packed, uint32_t capacity) {
+        std::vector<uint32_t> seen(poses.size(), 0);
+        for (size_t b = 0; b < packed.bins.size(); ++b)
+        {
+            const auto& bin = packed.bins[b];
+            ASSERT_LE(bin.size(), capacity);
+            ASSERT_TRUE(std::is_sorted(bin.begin(), bin.end()));
+            double binCost = 0;
+            for (uint32_t pose : bin)
+            {
+                ++seen[pose];
+                binCost += costs[pose];
+            }
+            ASSERT_NEAR(binCost, packed.binCosts[b], 1e-9);
+        }
+        ASSERT_EQ(std::count(seen.begin(), seen.end(), 1u), static_cast<long>(poses.size()));
+    };
+
+    // Worker loads are within the LPT bound of the average load, and never worse than equal
+    // count chunks of the same order.
+    const uint32_t kWorkers = 8;
+    BatchPacker::packing workers = BatchPacker::assignWorkers(poses, costs, kWorkers);
+    ASSERT_EQ(workers.bins.size(), kWorkers);
+    checkPacking(workers, UINT32_MAX);
+    const double maxLoad = *std::max_element(workers.binCosts.begin(), workers.binCosts.end());
+    ASSERT_LE(maxLoad, totalCost / kWorkers + maxCost);
+    double maxChunk = 0;
+    const size_t chunkSize = (poses.size() + kWorkers - 1) / kWorkers;
+    for (size_t begin = 0; begin < poses.size(); begin += chunkSize)
+    {
+        const size_t end = std::min(poses.size(), begin + chunkSize);
+        maxChunk = std::max(maxChunk, std::accumulate(costs.begin() + begin, costs.begin() + end, 0.0));
+    }
+    ASSERT_LE(maxLoad, maxChunk);
+
+    // Mini-batches respect the batch size.
+    BatchPacker::packing batches = BatchPacker::packBatches(poses, costs, 64);
+    ASSERT_EQ(batches.bins.size(), (poses.size() + 63) / 64);
+    checkPacking(batches, 64);
+    ASSERT_THROW(BatchPacker::assignWorkers(poses, costs, 0), std::invalid_argument);
+    ASSERT_THROW(BatchPacker::packBatches(poses, {}, 64), std::invalid_argument);
+
+    // With frame groups, we expect all poses of a frame to go to one worker, and to one batch
+    // as the batch size is a multiple of the use count.
+    PoseGenerator grouped(configRules, testSensorNames, 1);
+    grouped.setDeliveryMode(PoseGenerator::ShuffleFrameGroups);
+    std::vector<Augmenter::Pose> groupedPoses = grouped.generateShuffledPoses(vecUseCounts, labelFileName);
+    const std::vector<double> groupedCosts    = packer.estimateCosts(groupedPoses);
+    auto checkFramesWhole = [&](const BatchPacker::packing& packed) {
+        std::vector<uint32_t> frameBins(vecUseCounts.size(), UINT32_MAX);
+        for (uint32_t b = 0; b < packed.bins.size(); ++b)
+        {
+            for (uint32_t pose : packed.bins[b])
+            {
+                uint32_t& bin = frameBins[groupedPoses[pose].srcFrame];
+                ASSERT_TRUE(bin == UINT32_MAX || bin == b) << "frame " << groupedPoses[pose].srcFrame;
+                bin = b;
+            }
+        }
+    };
+    checkFramesWhole(BatchPacker::assignWorkers(groupedPoses, groupedCosts, kWorkers));
+    BatchPacker::packing groupedBatches = BatchPacker::packBatches(groupedPoses, groupedCosts, 63);
+    checkFramesWhole(groupedBatches);
+
+    // Every batch holds poses of one window of consecutive delivered poses only.
+    const uint32_t windowSize = BatchPacker::kWindowBatches * 63;
+    for (uint32_t b = 0; b < groupedBatches.bins.size(); ++b)
+    {
+        ASSERT_FALSE(groupedBatches.bins[b].empty());
+        ASSERT_EQ(groupedBatches.bins[b].front() / windowSize, b / BatchPacker::kWindowBatches);
+        ASSERT_EQ(groupedBatches.bins[b].back() / windowSize, b / BatchPacker::kWindowBatches);
+    }
+}
+
+TEST_F(PoseGeneratorTest, TestStratifiedDelivery_L0)
+{
+    std::string labelFileName = TestsDataPath::get() + "FILENAME.csv"; // YOUR FILE NAME
+    projMetaData::projMetaTrace trace(labelFileName);
+    // Frames 0 and 1 are highway frames (rule 0, half flipped), all others local (rule 1).
+    std::vector<uint32_t> vecUseCounts(trace.getNumDatapoints(), 10);
+    vecUseCounts[0] = 300;
+    vecUseCounts[1] = 300;
+    testObject->setDeliveryMode(PoseGenerator::ShuffleStrata);
+    std::vector<Augmenter::Pose> poses = testObject->generateShuffledPoses(vecUseCounts, labelFileName);
+    const size_t numPoses = std::accumulate(vecUseCounts.begin(), vecUseCounts.end(), size_t(0));
+    ASSERT_EQ(poses.size(), numPoses);
+    ASSERT_FALSE(poses[0].flip);
+
+    auto stratum = [](const Augmenter::Pose& pose) { return pose.srcFrame < 2 ? 2 * pose.flip : 1; };
+    std::array<size_t, 3> totals = {0, 0, 0};
+    std::vector<uint32_t> perFrame(vecUseCounts.size(), 0);
+    for (const auto& pose : poses)
+    {
+        ++totals[stratum(pose)];
+        ++perFrame[pose.srcFrame];
+    }
+    ASSERT_EQ(perFrame, vecUseCounts);
+    ASSERT_EQ(totals[0], 300u);
+    ASSERT_EQ(totals[2], 300u);
+
+    // Every window holds every stratum in its overall proportion, give or take two poses
+    // (one for the window edges, one for moving an unflipped pose to the front).
+    const size_t kWindow = 32;
+    for (size_t begin = 0; begin + kWindow <= poses.size(); ++begin)
+    {
+        std::array<size_t, 3> counts = {0, 0, 0};
+        for (size_t i = begin; i < begin + kWindow; ++i)
+        {
+            ++counts[stratum(poses[i])];
+        }
+        for (size_t s = 0; s < counts.size(); ++s)
+        {
+            const double expected = static_cast<double>(kWindow) * totals[s] / numPoses;
+            ASSERT_NEAR(counts[s], expected, 2.0) << "window at " << begin << ", stratum " << s;
+        }
+    }
+
+    // Orders differ between calls.
+    std::vector<Augmenter::Pose> again = testObject->generateShuffledPoses(vecUseCounts, labelFileName);
+    size_t sameFrame = 0;
+    for (size_t i = 0; i < poses.size(); ++i)
+    {
+        sameFrame += poses[i].srcFrame == again[i].srcFrame;
+    }
+    ASSERT_LT(sameFrame, poses.size() / 2);
+}
+
+TEST_F(PoseGeneratorTest, TestGenerateEpochs_L0)
+{
+    std::string labelFileName = TestsDataPath::get() + "FILENAME.csv"; // YOUR FILE NAME
+    projMetaData::projMetaTrace trace(labelFileName);
+    std::vector<uint32_t> vecUseCounts(trace.getNumDatapoints(), 2);
+    vecUseCounts[5] = 0;
+
+    const uint32_t kEpochs = 3;
+    std::vector<std::vector<Augmenter::Pose>> epochs =
+        testObject->generateEpochs(vecUseCounts, labelFileName, kEpochs);
+    ASSERT_EQ(epochs.size(), kEpochs);
+    for (const auto& poses : epochs)
+    {
+        // Every epoch is a complete, shuffled pose set.
+        std::vector<uint32_t> perFrame(vecUseCounts.size(), 0);
+        for (const auto& pose : poses)
+        {
+            ++perFrame[pose.srcFrame];
+        }
+        ASSERT_EQ(perFrame, vecUseCounts);
+        ASSERT_FALSE(poses[0].flip);
+    }
+    ASSERT_EQ(testObject->getDeliveryStatistics().numPoses, epochs.back().size());
+
+    // Epochs draw their own poses.
+    size_t sameShift = 0;
+    for (size_t i = 0; i < epochs[0].size(); ++i)
+    {
+        sameShift += epochs[0][i].shift == epochs[1][i].shift;
+    }
+    ASSERT_LT(sameShift, epochs[0].size() / 10);
+
+    // The delivery mode applies to every epoch, and mismatching traces still fail upfront.
+    testObject->setDeliveryMode(PoseGenerator::ShuffleFrameGroups);
+    epochs = testObject->generateEpochs(vecUseCounts, labelFileName, 2);
+    for (const auto& poses : epochs)
+    {
+        size_t runs = 0;
+        for (size_t i = 0; i < poses.size(); ++i)
+        {
+            runs += i == 0 || poses[i].srcFrame != poses[i - 1].srcFrame;
+        }
+        ASSERT_EQ(runs, vecUseCounts.size() - 1);
+    }
+    ASSERT_TRUE(testObject->generateEpochs(vecUseCounts, labelFileName, 0).empty());
+    vecUseCounts.push_back(1);
+    ASSERT_THROW(testObject->generateEpochs(vecUseCounts, labelFileName, 2), std::invalid_argument);
+}
+
+TEST_F(PoseGeneratorTest, TestEnsembleGeneration_L0)
+{
+    std::string labelFileName = TestsDataPath::get() + "FILENAME.csv"; // YOUR FILE NAME
+    projMetaData::projMetaTrace trace(labelFileName);
+    std::vector<uint32_t> vecUseCounts(trace.getNumDatapoints(), 3);
+    auto expectSamePoses = [](const std::vector<Augmenter::Pose>& a, const std::vector<Augmenter::Pose>& b) {
+        ASSERT_EQ(a.size(), b.size());
+        for (size_t i = 0; i < a.size(); ++i)
+        {
+            ASSERT_EQ(a[i].srcFrame, b[i].srcFrame) << "pose " << i;
+            ASSERT_EQ(a[i].flip, b[i].flip) << "pose " << i;
+            ASSERT_EQ(a[i].shift, b[i].shift) << "pose " << i;
+            ASSERT_EQ(a[i].rotation, b[i].rotation) << "pose " << i;
+            ASSERT_EQ(a[i].sensor_yaw, b[i].sensor_yaw) << "pose " << i;
+            ASSERT_EQ(a[i].sensor_roll, b[i].sensor_roll) << "pose " << i;
+        }
+    };
+
+    // We expect every set to hold the poses of every frame, within the bounds of its rule and
+    // delivered in frame groups, each group starting with an unflipped pose.
+    const std::vector<uint64_t> seeds = {7, 8, 9, (1ull << 32) + 7};
+    testObject->enableStatistics(true);
+    testObject->setDeliveryMode(PoseGenerator::ShuffleFrameGroups);
+    PoseEnsemble ensemble = testObject->generateEnsemble(vecUseCounts, labelFileName, seeds);
+    ASSERT_EQ(ensemble.size(), seeds.size());
+    ASSERT_EQ(ensemble.getNumPoses(), 3 * vecUseCounts.size());
+    ASSERT_EQ(ensemble.getSensorNames(), testSensorNames);
+    const double maxShift    = std::max(configRules[0].second.shift.max, configRules[1].second.shift.max);
+    const double maxRotation = std::max(configRules[0].second.rotation.max, configRules[1].second.rotation.max);
+    std::vector<std::vector<Augmenter::Pose>> sets;
+    for (size_t s = 0; s < ensemble.size(); ++s)
+    {
+        sets.push_back(ensemble.getPoses(s));
+        const std::vector<Augmenter::Pose>& poses = sets.back();
+        std::vector<uint32_t> counts(vecUseCounts.size(), 0);
+        for (size_t i = 0; i < poses.size(); ++i)
+        {
+            const Augmenter::Pose& pose = poses[i];
+            ++counts[pose.srcFrame];
+            const bool groupStart = i == 0 || pose.srcFrame != poses[i - 1].srcFrame;
+            ASSERT_EQ(groupStart, counts[pose.srcFrame] == 1) << "set " << s << " pose " << i;
+            ASSERT_TRUE(!groupStart || !pose.flip) << "set " << s << " pose " << i;
+            ASSERT_TRUE(valueInBound(pose.shift, maxShift)) << "set " << s << " pose " << i;
+            ASSERT_TRUE(valueInBound(pose.rotation, maxRotation)) << "set " << s << " pose " << i;
+            ASSERT_EQ(pose.sensor_yaw.size(), testSensorNames.size());
+            ASSERT_EQ(pose.sensor_roll.size(), testSensorNames.size());
+        }
+        ASSERT_EQ(counts, vecUseCounts) << "set " << s;
+
+        // Filling one pose object in place gives the same poses.
+        Augmenter::Pose reused = {};
+        for (size_t i = 0; i < poses.size(); ++i)
+        {
+            ensemble.getPose(s, i, reused);
+            expectSamePoses({reused}, {poses[i]});
+        }
+    }
+    ASSERT_THROW(ensemble.getPose(seeds.size(), 0), std::out_of_range);
+    ASSERT_NE(sets[0][0].shift, sets[2][0].shift);
+    // Seeds differing only above 32 bits give different sets.
+    ASSERT_NE(sets[0][0].shift, sets[3][0].shift);
+
+    // Every set only depends on its own seed, not on the other seeds or their order.
+    PoseEnsemble subset = testObject->generateEnsemble(vecUseCounts, labelFileName, {9, 7});
+    expectSamePoses(subset.getPoses(0), sets[2]);
+    expectSamePoses(subset.getPoses(1), sets[0]);
+
+    // Delivery statistics are returned per set; statistics and the outputs of
+    // generateShuffledPoses are left alone.
+    const auto& deliveries = testObject->getEnsembleDeliveryStatistics();
+    ASSERT_EQ(deliveries.size(), 2u);
+    for (const auto& delivery : deliveries)
+    {
+        ASSERT_EQ(delivery.numPoses, 3 * vecUseCounts.size());
+        ASSERT_EQ(delivery.numFrames, vecUseCounts.size());
+        ASSERT_EQ(delivery.numDecodes, vecUseCounts.size());
+    }
+    ASSERT_EQ(testObject->getDeliveryStatistics().numPoses, 0u);
+    ASSERT_EQ(testObject->getStatistics()->numPoses(0) + testObject->getStatistics()->numPoses(1), 0u);
+
+    // Poses of every lane pass the validity model, checked as delivered.
+    PoseValidity validity;
+    validity.setSensorModel("center", {1000, 1000, 960, 540, 1600, 800, 100, 0, 1920, 1080, 20});
+    testObject->setValidityModel(validity);
+    PoseEnsemble valid = testObject->generateEnsemble(vecUseCounts, labelFileName, seeds);
+    ASSERT_GT(testObject->getNumRejectedPoses(), 0u);
+    for (size_t s = 0; s < valid.size(); ++s)
+    {
+        for (const Augmenter::Pose& pose : valid.getPoses(s))
+        {
+            ASSERT_TRUE(validity.isValid(pose));
+        }
+    }
+    testObject->setValidityModel(PoseValidity());
+
+    // The generator's own stream is untouched, also when ordering throws (GOP index mismatch).
+    testObject->setGopIndex(std::vector<uint32_t>(vecUseCounts.size() + 1, 0));
+    testObject->setDeliveryMode(PoseGenerator::ShuffleGopBlocks);
+    ASSERT_THROW(testObject->generateEnsemble(vecUseCounts, labelFileName, seeds), std::invalid_argument);
+    testObject->setDeliveryMode(PoseGenerator::ShufflePoses);
+    PoseGenerator fresh(configRules, testSensorNames, 1);
+    expectSamePoses(testObject->generateShuffledPoses(vecUseCounts, labelFileName),
+                    fresh.generateShuffledPoses(vecUseCounts, labelFileName));
+    ASSERT_EQ(testObject->generateEnsemble(vecUseCounts, labelFileName, {}).size(), 0u);
+}
+
 } // namespace
@@ -0,0 +1,439 @@
+/*******************************************************************************
+*
+* @file TestRuleSet.cpp
+*
+******************************************************************************/
+
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+
+#include <zlib.h>
+
+#include "csvIndex.hpp"
+#include "gtest/gtest.h"
+#include "gzipReader.hpp"
+#include "ruleSet.hpp"
+
+namespace
+{
+
+// The fixture for testing class RuleSet (and the LabelTable it is evaluated on)
+class RuleSetTest : public ::testing::Test
+{
+protected:
+    std::string labelFileName;
+
+    virtual void SetUp()
+    {
+        // Example trace with one string and two numeric labels; speed is empty in frame 5.
+        labelFileName = (std::filesystem::temp_directory_path() / "ruleSetTest.csv").string();
+        std::ofstream out(labelFileName);
+        out << "road_type,speed,curvature\n"
+            << "highway,35.0,0.001\n"
+            << "highway,20,0.02\n"
+            << "local,40,-0.05\n"
+            << "\"local\",19.99,0.01\n"
+            << "local,60,0.0\n"
+            << "highway,,0.5\n";
+    }
+    virtual void TearDown()
+    {
+        std::filesystem::remove(labelFileName);
+    }
+
+    std::vector<int32_t> resolve(const std::vector<std::string>& rules)
+    {
+        RuleSet ruleSet(rules);
+        LabelTable labels(labelFileName, ruleSet.getFieldNames());
+        std::vector<int32_t> resolved = ruleSet.resolve(labels);
+
+        // We expect the per-row path to agree with the column-wise path.
+        for (uint32_t row = 0; row < labels.getNumRows(); ++row)
+        {
+            EXPECT_EQ(ruleSet.resolveRow(labels, row), resolved[row]) << "row " << row;
+        }
+        return resolved;
+    }
+};
+
+const int32_t kNone = RuleSet::kNoRule;
+
+TEST_F(RuleSetTest, TestLabelTable_L0)
+{
+    LabelTable labels(labelFileName, {"road_type", "speed"});
+    ASSERT_EQ(labels.getNumRows(), 6u);
+    ASSERT_EQ(LabelTable::countRows(labelFileName), 6u);
+    ASSERT_TRUE(labels.isNumeric("speed"));
+    ASSERT_FALSE(labels.isNumeric("road_type"));
+
+    // Quoted cells are unquoted and interned with the unquoted ones.
+    ASSERT_EQ(labels.getDictionary("road_type").size(), 2u);
+    ASSERT_EQ(labels.getStringColumn("road_type")[3], labels.getStringColumn("road_type")[2]);
+
+    // Empty numeric cells become NaN.
+    ASSERT_DOUBLE_EQ(labels.getNumericColumn("speed")[1], 20.0);
+    ASSERT_TRUE(std::isnan(labels.getNumericColumn("speed")[5]));
+
+    ASSERT_THROW(LabelTable(labelFileName, {"no_such_field"}), std::invalid_argument);
+    ASSERT_THROW(labels.getNumericColumn("curvature"), std::invalid_argument);
+}
+
+TEST_F(RuleSetTest, TestLabelTableQuoting_L0)
+{
+    // Quoted commas, newlines and escaped quotes, CRLF line ends, a blank line and cells long
+    // enough for quoted regions to cross the 64-byte blocks of the structural scan.
+    const std::string longText(150, 'x');
+    const std::string fileName =
+        (std::filesystem::temp_directory_path() / "quotingTest.csv").string();
+    {
+        std::ofstream out(fileName, std::ios::binary);
+        out << "comment,road_type,speed\r\n"
+            << "\"" << longText << ",\n" << longText << "\",local,10\r\n"
+            << "\r\n"
+            << "\"say \"\"hi\"\", ok\",\"high,way\",20\n"
+            << "plain,local\n"
+            << "\"" << longText << "\",\"" << longText << "\",30";
+    }
+    LabelTable labels(fileName, {"road_type", "speed"});
+    const uint32_t countedRows = LabelTable::countRows(fileName);
+    LabelTable selected(fileName, {"road_type"}, {0, 1, 0, 1});
+    std::filesystem::remove(fileName);
+
+    ASSERT_EQ(labels.getNumRows(), 4u);
+    ASSERT_EQ(countedRows, 4u);
+    const auto& ids        = labels.getStringColumn("road_type");
+    const auto& dictionary = labels.getDictionary("road_type");
+    EXPECT_EQ(dictionary[ids[0]], "local");
+    EXPECT_EQ(dictionary[ids[1]], "high,way");
+    EXPECT_EQ(dictionary[ids[2]], "local");
+    EXPECT_EQ(dictionary[ids[3]], longText);
+    EXPECT_EQ(selected.getDictionary("road_type")[selected.getStringColumn("road_type")[1]], "high,way");
+    EXPECT_EQ(selected.getDictionary("road_type")[selected.getStringColumn("road_type")[3]], longText);
+
+    // Missing trailing cells are empty; the last line needs no newline.
+    const auto& speed = labels.getNumericColumn("speed");
+    EXPECT_DOUBLE_EQ(speed[0], 10.0);
+    EXPECT_DOUBLE_EQ(speed[1], 20.0);
+    EXPECT_TRUE(std::isnan(speed[2]));
+    EXPECT_DOUBLE_EQ(speed[3], 30.0);
+
+    // The index only reports separators outside quotes.
+    const std::string text = "a,\"b,\"\"c\n\"\nd";
+    CsvIndex index(text.data(), text.size());
+    EXPECT_EQ(index.getStructurals(), (std::vector<uint64_t>{1, 10}));
+    EXPECT_FALSE(index.endsInQuote());
+    EXPECT_EQ(CsvIndex::cellText(text.data(), 2, 10), "b,\"c\n");
+
+    // Blank lines, also with CRLF, and a missing final newline are handled by the line count.
+    const std::string lines = "\r\na\n\n\r\n\"\n\n\"\r\nb";
+    EXPECT_EQ(CsvIndex::countLines(lines.data(), lines.size()), 3u);
+}
+
+TEST_F(RuleSetTest, TestLeadingBlankLines_L0)
+{
+    // The header is the first non-blank line for both the line count and the parser.
+    const std::string fileName = (std::filesystem::temp_directory_path() / "ruleSetBlank.csv").string();
+    {
+        std::ofstream out(fileName);
+        out << "\r\n\nroad_type,speed\nlocal,10\n\nhighway,20\n";
+    }
+    EXPECT_EQ(LabelTable::countRows(fileName), 2u);
+    LabelTable labels(fileName, {"road_type", "speed"});
+    EXPECT_EQ(labels.getNumRows(), 2u);
+    EXPECT_DOUBLE_EQ(labels.getNumericColumn("speed")[1], 20.0);
+    EXPECT_EQ(LabelTable(fileName, {"speed"}, {1, 0}).getNumRows(), 2u);
+    EXPECT_EQ(LabelTable(fileName, {"speed"}, {1, 1}).getNumRows(), 2u);
+    std::filesystem::remove(fileName);
+}
+
+TEST_F(RuleSetTest, TestSelectiveLoad_L0)
+{
+    // Only rows with a nonzero use count are converted; the others hold empty values.
+    LabelTable labels(labelFileName, {"road_type", "speed"}, {1, 0, 2, 0, 0, 1});
+    ASSERT_EQ(labels.getNumRows(), 6u);
+    const auto& speed      = labels.getNumericColumn("speed");
+    const auto& ids        = labels.getStringColumn("road_type");
+    const auto& dictionary = labels.getDictionary("road_type");
+    EXPECT_DOUBLE_EQ(speed[0], 35.0);
+    EXPECT_TRUE(std::isnan(speed[1]));
+    EXPECT_DOUBLE_EQ(speed[2], 40.0);
+    EXPECT_TRUE(std::isnan(speed[3]));
+    EXPECT_EQ(dictionary[ids[0]], "highway");
+    EXPECT_EQ(dictionary[ids[2]], "local");
+    EXPECT_EQ(dictionary[ids[4]], "");
+    EXPECT_EQ(dictionary[ids[5]], "highway");
+
+    // Selected rows resolve as in a full load.
+    RuleSet ruleSet({"road_type=local speed>=20", "road_type=highway"});
+    std::vector<int32_t> full = ruleSet.resolve(LabelTable(labelFileName, ruleSet.getFieldNames()));
+    std::vector<int32_t> selected = ruleSet.resolve(labels);
+    EXPECT_EQ(selected[0], full[0]);
+    EXPECT_EQ(selected[2], full[2]);
+    EXPECT_EQ(selected[5], full[5]);
+
+    // Mostly used traces are indexed in one pass, with the same result.
+    LabelTable dense(labelFileName, {"speed"}, {1, 1, 0, 1, 1, 1});
+    EXPECT_DOUBLE_EQ(dense.getNumericColumn("speed")[1], 20.0);
+    EXPECT_TRUE(std::isnan(dense.getNumericColumn("speed")[2]));
+    EXPECT_DOUBLE_EQ(dense.getNumericColumn("speed")[4], 60.0);
+
+    ASSERT_THROW(LabelTable(labelFileName, {"speed"}, {1, 1, 1}), std::invalid_argument);
+}
+
+TEST_F(RuleSetTest, TestCompressedLabels_L0)
+{
+    // A gzip trace large enough to be decompressed in several chunks, with quoted newlines.
+    const uint32_t numFrames   = 200000;
+    const std::string fileName = (std::filesystem::temp_directory_path() / "compressedTest.csv.gz").string();
+    std::string content = "road_type,comment,speed\n";
+    for (uint32_t i = 0; i < numFrames; ++i)
+    {
+        content += (i % 3 ? "local" : "highway");
+        content += ",\"line\nbreak, " + std::to_string(i) + "\"," + std::to_string(i % 100) + "\n";
+    }
+    gzFile out = gzopen(fileName.c_str(), "wb");
+    ASSERT_NE(out, nullptr);
+    ASSERT_EQ(gzwrite(out, content.data(), content.size()), static_cast<int>(content.size()));
+    gzclose(out);
+    ASSERT_TRUE(GzipReader::isGzip(fileName));
+
+    // Chunks of the reader concatenate to the original content.
+    std::string streamed;
+    std::string chunk;
+    GzipReader reader(fileName, 4096, 2);
+    while (reader.next(chunk))
+    {
+        ASSERT_LE(chunk.size(), 4096u);
+        streamed += chunk;
+    }
+    EXPECT_EQ(streamed, content);
+
+    EXPECT_EQ(LabelTable::countRows(fileName), numFrames);
+    LabelTable labels(fileName, {"road_type", "speed"});
+    std::vector<uint32_t> useCounts(numFrames, 0);
+    useCounts[numFrames - 1] = 1;
+    LabelTable selected(fileName, {"speed"}, useCounts);
+
+    ASSERT_EQ(labels.getNumRows(), numFrames);
+    const auto& ids        = labels.getStringColumn("road_type");
+    const auto& dictionary = labels.getDictionary("road_type");
+    for (uint32_t i = 0; i < numFrames; ++i)
+    {
+        ASSERT_EQ(dictionary[ids[i]], i % 3 ? "local" : "highway") << "frame " << i;
+        ASSERT_DOUBLE_EQ(labels.getNumericColumn("speed")[i], i % 100) << "frame " << i;
+    }
+    EXPECT_DOUBLE_EQ(selected.getNumericColumn("speed")[numFrames - 1], (numFrames - 1) % 100);
+    EXPECT_TRUE(std::isnan(selected.getNumericColumn("speed")[0]));
+
+    // A truncated archive is an error, not a shorter trace.
+    const std::string truncatedName = fileName + ".truncated.gz";
+    {
+        std::ifstream in(fileName, std::ios::binary);
+        std::string compressed((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        std::ofstream(truncatedName, std::ios::binary).write(compressed.data(), compressed.size() / 2);
+    }
+    EXPECT_THROW(LabelTable(truncatedName, {"speed"}), std::runtime_error);
+    std::filesystem::remove(truncatedName);
+    std::filesystem::remove(fileName);
+}
+
+TEST_F(RuleSetTest, TestNumericRanges_L0)
+{
+    // Half-open interval: 20 is in, 40 is out, NaN is never in a range.
+    EXPECT_EQ(resolve({"speed in [20, 40)"}),
+              (std::vector<int32_t>{0, 0, kNone, kNone, kNone, kNone}));
+    // Both ends closed / open.
+    EXPECT_EQ(resolve({"speed in [20,40]"}), (std::vector<int32_t>{0, 0, 0, kNone, kNone, kNone}));
+    EXPECT_EQ(resolve({"speed in (20, 40)"}),
+              (std::vector<int32_t>{0, kNone, kNone, kNone, kNone, kNone}));
+    // Comparisons and equality.
+    EXPECT_EQ(resolve({"curvature>0.01"}), (std::vector<int32_t>{kNone, 0, kNone, kNone, kNone, 0}));
+    EXPECT_EQ(resolve({"curvature>=0.01"}), (std::vector<int32_t>{kNone, 0, kNone, 0, kNone, 0}));
+    EXPECT_EQ(resolve({"speed<20"}), (std::vector<int32_t>{kNone, kNone, kNone, 0, kNone, kNone}));
+    EXPECT_EQ(resolve({"speed<=20"}), (std::vector<int32_t>{kNone, 0, kNone, 0, kNone, kNone}));
+    EXPECT_EQ(resolve({"speed=40"}), (std::vector<int32_t>{kNone, kNone, 0, kNone, kNone, kNone}));
+    // Empty interval never matches.
+    EXPECT_EQ(resolve({"speed in [40, 20)"}), std::vector<int32_t>(6, kNone));
+}
+
+TEST_F(RuleSetTest, TestFirstMatchOrder_L0)
+{
+    // Mixed string and numeric conditions, resolved in first-match order.
+    EXPECT_EQ(resolve({"road_type=highway speed>=30", "speed>=20 speed<50", "road_type=local"}),
+              (std::vector<int32_t>{0, 1, 1, 2, 2, kNone}));
+}
+
+TEST_F(RuleSetTest, TestSetNegationWildcard_L0)
+{
+    // Set membership on string and numeric labels.
+    EXPECT_EQ(resolve({"road_type=local|highway speed=20|60"}),
+              (std::vector<int32_t>{kNone, 0, kNone, kNone, 0, kNone}));
+    // Negation admits values the rules never mention, and empty cells.
+    EXPECT_EQ(resolve({"road_type!=highway"}), (std::vector<int32_t>{kNone, kNone, 0, 0, 0, kNone}));
+    EXPECT_EQ(resolve({"road_type!=parking"}), std::vector<int32_t>(6, 0));
+    EXPECT_EQ(resolve({"speed!=40|60"}), (std::vector<int32_t>{0, 0, kNone, 0, kNone, 0}));
+    // Wildcards match everything, including empty numeric cells.
+    EXPECT_EQ(resolve({"speed=*"}), std::vector<int32_t>(6, 0));
+    EXPECT_EQ(resolve({"road_type=highway speed<30", "road_type=* curvature>0"}),
+              (std::vector<int32_t>{1, 0, kNone, 1, kNone, 1}));
+}
+
+TEST_F(RuleSetTest, TestTraceRows_L0)
+{
+    const std::string fileName = (std::filesystem::temp_directory_path() / "ruleSetTrace.csv").string();
+    {
+        std::ofstream out(fileName);
+        out << "road_type,speed\n"
+            << "highway,35\n"
+            << "local,20\n"
+            << "parking,5\n";
+    }
+    projMetaData::projMetaTrace trace(fileName);
+
+    // We expect string equalities to resolve on a trace as on a LabelTable.
+    RuleSet ruleSet({"road_type=highway", "road_type=local"});
+    LabelTable labels(fileName, ruleSet.getFieldNames());
+    for (uint32_t row = 0; row < 3; ++row)
+    {
+        EXPECT_EQ(ruleSet.resolveRow(trace, row), ruleSet.resolveRow(labels, row)) << "row " << row;
+    }
+    EXPECT_EQ(ruleSet.resolveRow(trace, 2), kNone);
+
+    // Other conditions cannot be checked by doLabelsMatch().
+    EXPECT_THROW(RuleSet({"road_type=local|highway"}).resolveRow(trace, 0), std::invalid_argument);
+    EXPECT_THROW(RuleSet({"road_type!=local"}).resolveRow(trace, 0), std::invalid_argument);
+    EXPECT_THROW(RuleSet({"speed>=20"}).resolveRow(trace, 0), std::invalid_argument);
+    std::filesystem::remove(fileName);
+}
+
+TEST_F(RuleSetTest, TestManyThresholds_L0)
+{
+    // Enough thresholds on one field to use the binary-searched threshold index and masks
+    // spanning more than one word.
+    std::vector<std::string> rules;
+    for (int k = 69; k >= 0; --k)
+    {
+        rules.push_back("speed>=" + std::to_string(k));
+    }
+    EXPECT_EQ(resolve(rules), (std::vector<int32_t>{34, 49, 29, 50, 9, kNone}));
+}
+
+TEST_F(RuleSetTest, TestFindUncovered_L0)
+{
+    const std::vector<int32_t> resolved = {0, kNone, kNone, 1, kNone, kNone, kNone, 0, kNone};
+    const std::vector<uint32_t> useCounts = {1, 2, 2, 1, 1, 0, 3, 1, 1};
+
+    // Frames with a zero use count split ranges but are never reported.
+    std::vector<RuleSet::frameRange> uncovered = RuleSet::findUncovered(resolved, useCounts);
+    ASSERT_EQ(uncovered.size(), 4u);
+    EXPECT_EQ(uncovered[0].first, 1u);
+    EXPECT_EQ(uncovered[0].last, 2u);
+    EXPECT_EQ(uncovered[1].first, 4u);
+    EXPECT_EQ(uncovered[1].last, 4u);
+    EXPECT_EQ(uncovered[2].first, 6u);
+    EXPECT_EQ(uncovered[2].last, 6u);
+    EXPECT_EQ(uncovered[3].first, 8u);
+    EXPECT_EQ(uncovered[3].last, 8u);
+
+    EXPECT_TRUE(RuleSet::findUncovered(resolved, std::vector<uint32_t>(9, 0)).empty());
+}
+
+TEST_F(RuleSetTest, TestDeadRules_L0)
+{
+    // Rule 1 is shadowed by rule 0, rule 2 can never match, rule 4 is shadowed by rules 0 and
+    // 3 together, rule 5 is not shadowed (other road types).
+    RuleSet ruleSet({"road_type=highway|local", "road_type=local speed>30", "speed>40 speed<20",
+                     "road_type=parking", "road_type=highway|parking", "road_type!=local"});
+    EXPECT_EQ(ruleSet.getDroppedRules(), (std::vector<uint32_t>{1, 2, 4}));
+    ASSERT_EQ(ruleSet.getWarnings().size(), 3u);
+    EXPECT_NE(ruleSet.getWarnings()[0].find("shadowed by rule 0"), std::string::npos);
+    EXPECT_NE(ruleSet.getWarnings()[1].find("can never match"), std::string::npos);
+    EXPECT_EQ(ruleSet.size(), 6u);
+
+    // Dropped rules never fire, the remaining ones keep their original indices.
+    LabelTable labels(labelFileName, ruleSet.getFieldNames());
+    EXPECT_EQ(ruleSet.resolve(labels), std::vector<int32_t>(6, 0));
+}
+
+TEST_F(RuleSetTest, TestDeadRulesManyFields_L0)
+{
+    // 16 fields of 16 symbols each: 2^64 tuples, far beyond the enumeration budget. Rule 1
+    // admits the "other" symbol of every field, so rule 0 does not shadow it.
+    std::string values;
+    for (int v = 1; v <= 15; ++v)
+    {
+        values += (v > 1 ? "|v" : "v") + std::to_string(v);
+    }
+    std::string rule0;
+    for (int f = 0; f < 16; ++f)
+    {
+        rule0 += (f > 0 ? " label" : "label") + std::to_string(f) + "=" + values;
+    }
+    RuleSet ruleSet({rule0, "label0=*"});
+    EXPECT_TRUE(ruleSet.getDroppedRules().empty());
+}
+
+TEST_F(RuleSetTest, TestReorderDisjointRules_L0)
+{
+    // Overlapping rules keep first-match order.
+    RuleSet overlapping({"road_type=highway", "speed>=20"});
+    EXPECT_FALSE(overlapping.areRulesDisjoint());
+
+    std::vector<std::string> rules = {"speed<20", "speed in [20, 40)", "speed>=40 road_type=local",
+                                      "speed>=40 road_type=highway"};
+    RuleSet ruleSet(rules);
+    ASSERT_TRUE(ruleSet.areRulesDisjoint());
+
+    LabelTable labels(labelFileName, ruleSet.getFieldNames());
+    const std::vector<int32_t> expected = {1, 1, 2, 0, 2, kNone};
+    ASSERT_EQ(ruleSet.resolve(labels), expected);
+
+    // Reordering by hits changes evaluation order, never the result.
+    ruleSet.reorderByHits(expected);
+    EXPECT_EQ(ruleSet.resolve(labels), expected);
+    for (uint32_t row = 0; row < labels.getNumRows(); ++row)
+    {
+        EXPECT_EQ(ruleSet.resolveRow(labels, row), expected[row]);
+    }
+}
+
+TEST_F(RuleSetTest, TestMemoSharedAcrossRuleSets_L0)
+{
+    // A rule list no other test uses, so the process-wide memo starts empty.
+    const std::vector<std::string> rules = {"road_type=highway speed>=30", "curvature<=0.01"};
+    RuleSet first(rules);
+    RuleSet second(rules);
+    RuleSet other({"road_type=local"});
+    ASSERT_EQ(first.getMemoSize(), 0u);
+
+    LabelTable labels(labelFileName, first.getFieldNames());
+    const std::vector<int32_t> resolved = first.resolve(labels);
+    EXPECT_EQ(resolved, (std::vector<int32_t>{0, kNone, 1, 1, 1, kNone}));
+
+    // Rows 2 and 4 share a tuple (local, speed>=30, curvature<=0.01); the memo is shared by
+    // identical rule lists only.
+    EXPECT_EQ(first.getMemoSize(), 5u);
+    EXPECT_EQ(second.getMemoSize(), 5u);
+    EXPECT_EQ(other.getMemoSize(), 0u);
+    EXPECT_EQ(second.resolve(labels), resolved);
+    EXPECT_EQ(second.getMemoSize(), 5u);
+}
+
+TEST_F(RuleSetTest, TestInvalidRules_L0)
+{
+    // Numeric comparisons on string labels are rejected.
+    ASSERT_THROW(RuleSet({"road_type>3"}), std::invalid_argument);
+    // Numeric labels need numbers.
+    ASSERT_THROW(RuleSet({"speed=fast"}), std::invalid_argument);
+    ASSERT_THROW(RuleSet({"speed in [20, 40"}), std::invalid_argument);
+    ASSERT_THROW(RuleSet({"road_type"}), std::invalid_argument);
+    ASSERT_THROW(RuleSet({"=highway"}), std::invalid_argument);
+    ASSERT_THROW(RuleSet({"road_type=highway|"}), std::invalid_argument);
+    ASSERT_THROW(RuleSet({"road_type=a||b"}), std::invalid_argument);
+    ASSERT_THROW(RuleSet({"road_type=*|local"}), std::invalid_argument);
+    ASSERT_THROW(RuleSet({"road_type!=*"}), std::invalid_argument);
+    ASSERT_THROW(RuleSet({"road_type!highway"}), std::invalid_argument);
+}
+
+} // namespace
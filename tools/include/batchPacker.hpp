@@ -0,0 +1,164 @@
+/*******************************************************************************
+ *
+ * @file batchPacker.hpp
+ *
+ ******************************************************************************/
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <augmenter.hpp>
+
+/**
+ * @brief
+ * Splits delivered poses into worker assignments or mini-batches of balanced augmentation
+ * cost, instead of chunks of equal pose counts, so that the slowest worker of a step is not
+ * held up by a chunk of expensive poses.
+ *
+ * Costs come from a linear model (a cost per pose, per sensor and for flipping) that can be
+ * corrected with costs measured by the Augmenter, or are passed in directly.
+ *
+ * Packing keeps the decode locality of the delivery mode: poses are packed as decode runs,
+ * i.e. maximal runs of consecutive poses of the same frame (ShuffleFrameGroups) or, given a
+ * GOP index, of the same GOP (ShuffleGopBlocks), and a run goes to a single bin whenever it
+ * fits. Runs are placed with the longest-processing-time-first greedy: by descending cost,
+ * each to the bin with the lowest total so far, which keeps the largest worker load below
+ * the average load plus the most expensive run, in O(n log n). Mini-batches are packed
+ * within windows of consecutive poses of the delivered order, so every mini-batch only
+ * holds poses from a short stretch of it. Each bin lists its poses in delivery order.
+ */
+class BatchPacker
+{
+public:
+    /* Linear augmentation cost model, in any unit (e.g. microseconds). */
+    struct costModel
+    {
+        /* Cost of every pose. */
+        double poseCost;
+        /* Extra cost of a flipped pose. */
+        double flipCost;
+        /* Cost of every sensor of a pose, e.g. proportional to its resolution; sensors not
+         * listed cost nothing. */
+        std::map<std::string, double> sensorCosts;
+    };
+
+    /* Poses per bin, as indices into the packed poses in delivery order, and bin costs. */
+    struct packing
+    {
+        std::vector<std::vector<uint32_t>> bins;
+        std::vector<double> binCosts;
+    };
+
+    /**
+     * @brief
+     * Creates a packer with a cost model.
+     *
+     * @param[in] model         : the initial cost model.
+     */
+    explicit BatchPacker(const costModel& model);
+
+    /**
+     * @brief
+     * Returns the modeled cost of a pose, corrected by the measured costs recorded so far.
+     *
+     * @param[in] pose          : the pose.
+     */
+    double estimateCost(const Augmenter::Pose& pose) const;
+
+    /**
+     * @brief
+     * Returns the modeled costs of a list of poses.
+     *
+     * @param[in] poses         : poses in delivery order.
+     */
+    std::vector<double> estimateCosts(const std::vector<Augmenter::Pose>& poses) const;
+
+    /**
+     * @brief
+     * Feeds back the cost the Augmenter measured for a pose. Flipped and unflipped poses
+     * each keep the ratio of their measured to their modeled cost, as an exponential moving
+     * average, and later estimates are scaled by it.
+     *
+     * @param[in] pose          : the augmented pose.
+     * @param[in] measuredCost  : its measured cost, in the unit of the model.
+     */
+    void recordCost(const Augmenter::Pose& pose, double measuredCost);
+
+    /**
+     * @brief
+     * Assigns poses to workers with balanced total cost; every decode run goes to one
+     * worker.
+     *
+     * @param[in] poses         : poses in delivery order.
+     * @param[in] costs         : the cost of every pose, in delivery order.
+     * @param[in] numWorkers    : the number of workers (bins).
+     * @param[in] keyframeOffsets: the GOP index of the trace (see PoseGenerator::setGopIndex),
+     *                            to keep runs of one GOP together; empty for frame runs.
+     */
+    static packing assignWorkers(const std::vector<Augmenter::Pose>& poses,
+                                 const std::vector<double>& costs,
+                                 uint32_t numWorkers,
+                                 const std::vector<uint32_t>& keyframeOffsets = {});
+
+    /**
+     * @brief
+     * Packs poses into ceil(n / batchSize) mini-batches of at most batchSize poses with
+     * balanced total cost. Batches are packed kWindowBatches at a time from consecutive poses
+     * of the delivered order; a decode run is only split where it crosses a window or does
+     * not fit any batch of its window whole.
+     *
+     * @param[in] poses         : poses in delivery order.
+     * @param[in] costs         : the cost of every pose, in delivery order.
+     * @param[in] batchSize     : the most poses per mini-batch.
+     * @param[in] keyframeOffsets: the GOP index of the trace (see PoseGenerator::setGopIndex),
+     *                            to keep runs of one GOP together; empty for frame runs.
+     */
+    static packing packBatches(const std::vector<Augmenter::Pose>& poses,
+                               const std::vector<double>& costs,
+                               uint32_t batchSize,
+                               const std::vector<uint32_t>& keyframeOffsets = {});
+
+    /* Mini-batches packed together from one window of the delivered order. */
+    static constexpr uint32_t kWindowBatches = 8;
+
+private:
+    /* Weight of a new measurement in the moving averages of the correction ratios. */
+    static constexpr double kCorrectionWeight = 0.05;
+
+    /* Modeled cost of a pose without correction. */
+    double modelCost(const Augmenter::Pose& pose) const;
+
+    /* A decode run: poses [begin, end) of the delivered order and their total cost. */
+    struct decodeRun
+    {
+        uint32_t begin;
+        uint32_t end;
+        double cost;
+    };
+
+    /* Splits poses into decode runs; throws if costs or the GOP index do not fit the poses. */
+    static std::vector<decodeRun> findRuns(const std::vector<Augmenter::Pose>& poses,
+                                           const std::vector<double>& costs,
+                                           const std::vector<uint32_t>& keyframeOffsets);
+
+    /* LPT packing of whole runs into the bins [firstBin, firstBin + numBins) of a packing; a
+     * run that fits no bin whole is split over the bins with the most room left. */
+    static void pack(const std::vector<double>& costs,
+                     std::vector<decodeRun> runs,
+                     uint32_t firstBin,
+                     uint32_t numBins,
+                     uint32_t capacity,
+                     packing& result);
+
+    costModel m_model;
+
+    /* Measured to modeled cost ratios of unflipped [0] and flipped [1] poses. */
+    std::array<double, 2> m_corrections;
+
+    /* True once a ratio has a measurement. */
+    std::array<bool, 2> m_measured;
+};
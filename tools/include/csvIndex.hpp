@@ -0,0 +1,79 @@
+/*******************************************************************************
+ *
+ * @file csvIndex.hpp
+ *
+ ******************************************************************************/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief
+ * Structural index of a CSV buffer: the offsets of every comma and newline outside quotes,
+ * in order (or of the newlines only, for callers that just need line boundaries). Cells of a
+ * row are the spans between consecutive structurals, and a structural that is a newline ends
+ * a row. This lets column extractors jump straight to the cells they need instead of
+ * re-scanning bytes.
+ *
+ * The buffer is classified 64 bytes at a time into comma, quote and newline bitmasks (AVX2
+ * when the CPU supports it, SSE2 otherwise on x86-64, a scalar loop elsewhere). Quoted
+ * regions come from a prefix XOR of the quote mask carried across blocks, so escaped quotes
+ * ("") and quoted commas or newlines are handled without per-byte branches.
+ */
+class CsvIndex
+{
+public:
+    /**
+     * @brief
+     * Indexes a buffer. The buffer must outlive the index.
+     *
+     * @param[in] data          : start of the CSV text.
+     * @param[in] size          : number of bytes.
+     * @param[in] newlinesOnly  : index only the unquoted newlines, i.e. line ends.
+     */
+    CsvIndex(const char* data, size_t size, bool newlinesOnly = false);
+
+    /**
+     * @brief
+     * Returns the offsets of all unquoted commas and newlines.
+     */
+    const std::vector<uint64_t>& getStructurals() const;
+
+    /**
+     * @brief
+     * Returns true if the buffer ends inside a quoted cell.
+     */
+    bool endsInQuote() const;
+
+    /**
+     * @brief
+     * Returns the text of the cell spanning [begin, end): surrounding quotes removed, ""
+     * unescaped and a trailing '\r' dropped.
+     *
+     * @param[in] data          : the indexed buffer.
+     * @param[in] begin         : offset of the first byte of the cell.
+     * @param[in] end           : offset of the structural that ends the cell.
+     */
+    static std::string cellText(const char* data, uint64_t begin, uint64_t end);
+
+    /**
+     * @brief
+     * Returns the number of non-blank lines of a CSV buffer (newlines inside quotes do not end
+     * a line), without building an index. A last line without a newline is counted.
+     *
+     * @param[in] data          : start of the CSV text.
+     * @param[in] size          : number of bytes.
+     */
+    static uint64_t countLines(const char* data, size_t size);
+
+private:
+    /* Appends the structurals of the buffer to m_structurals. */
+    void scan(const char* data, size_t size, bool newlinesOnly);
+
+    std::vector<uint64_t> m_structurals;
+
+    bool m_endsInQuote;
+};
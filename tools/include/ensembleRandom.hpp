@@ -0,0 +1,103 @@
+/*******************************************************************************
+ *
+ * @file ensembleRandom.hpp
+ *
+ ******************************************************************************/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief
+ * Independent random streams for an ensemble of seeds, one lane per seed, advanced together.
+ * Every lane is a xoshiro256+ generator seeded from its seed through splitmix64. The lane
+ * states are kept as structure-of-arrays, padded to whole tiles of kTile lanes, and stepped
+ * tile by tile in loops of constant length, so the compiler maps SIMD lanes to seeds at -O2
+ * already. Draws take a mask of active lanes and only advance those, so every lane consumes
+ * its stream exactly as if it ran alone: the values of a seed do not depend on the other
+ * seeds of the ensemble.
+ *
+ * Gaussian values use the Box-Muller transform (the cosine branch, one value per two
+ * uniforms) with per-lane rejection outside the hard limit. Streams differ from the
+ * std::mt19937_64 and std::normal_distribution draws of PoseGenerator, so an ensemble lane
+ * does not reproduce a PoseGenerator run with the same seed.
+ */
+class EnsembleRandom
+{
+public:
+    /* Lanes stepped per loop of constant length. */
+    static constexpr size_t kTile = 8;
+
+    /**
+     * @brief
+     * Seeds one lane per seed.
+     *
+     * @param[in] seeds         : the seed of every lane.
+     */
+    explicit EnsembleRandom(const std::vector<uint64_t>& seeds);
+
+    /**
+     * @brief
+     * Returns the number of lanes.
+     */
+    size_t size() const;
+
+    /**
+     * @brief
+     * Draws a uniform double in [0, 1) for every active lane.
+     *
+     * @param[in] active        : nonzero for every lane to draw for.
+     * @param[out] values       : the drawn values; entries of inactive lanes are unchanged.
+     */
+    void uniform01(const uint8_t* active, double* values);
+
+    /**
+     * @brief
+     * Draws a uniform value in [-max, max) for every active lane.
+     *
+     * @param[in] max           : the hard limit.
+     * @param[in] active        : nonzero for every lane to draw for.
+     * @param[out] values       : the drawn values; entries of inactive lanes are unchanged.
+     */
+    void uniform(double max, const uint8_t* active, float* values);
+
+    /**
+     * @brief
+     * Draws a zero-mean Gaussian value within [-max, max] for every active lane; values
+     * outside are redrawn in the lanes that produced them.
+     *
+     * @param[in] stdDev        : the standard deviation; not positive draws zeros.
+     * @param[in] max           : the hard limit.
+     * @param[in] active        : nonzero for every lane to draw for.
+     * @param[out] values       : the drawn values; entries of inactive lanes are unchanged.
+     */
+    void gaussian(double stdDev, double max, const uint8_t* active, float* values);
+
+private:
+    /* Number of lanes, without the padding of the last tile. */
+    size_t m_numLanes;
+
+    /* Lane states, one array per xoshiro256 state word, padded to whole tiles. */
+    std::vector<uint64_t> m_s0;
+    std::vector<uint64_t> m_s1;
+    std::vector<uint64_t> m_s2;
+    std::vector<uint64_t> m_s3;
+
+    /* All ones for every lane the next step advances, zero otherwise (padding included). */
+    std::vector<uint64_t> m_mask;
+
+    /* Scratch buffers of the draws, padded to whole tiles. */
+    std::vector<double> m_u1;
+    std::vector<double> m_u2;
+    std::vector<float> m_degrees;
+    std::vector<float> m_sines;
+    std::vector<float> m_cosines;
+
+    /* Sets m_mask from the active lanes; returns the number of active lanes. */
+    size_t setMask(const uint8_t* active);
+
+    /* Advances the masked lanes and writes a uniform double in [0, 1) of every lane. */
+    void step(double* values);
+};
@@ -0,0 +1,95 @@
+/*******************************************************************************
+ *
+ * @file gzipReader.hpp
+ *
+ ******************************************************************************/
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+struct gzFile_s;
+
+/**
+ * @brief
+ * Streams the decompressed content of a gzip file in chunks. Decompression runs on its own
+ * thread and fills a bounded queue of chunks, so the consumer can parse one chunk while the
+ * next one is being inflated, without temporary files.
+ */
+class GzipReader
+{
+public:
+    /**
+     * @brief
+     * Opens a gzip file and starts decompressing it. Throws std::runtime_error if the file
+     * cannot be opened.
+     *
+     * @param[in] fileName          : the full path to the gzip file.
+     * @param[in] chunkSize         : the number of decompressed bytes per chunk.
+     * @param[in] maxQueuedChunks   : the number of chunks decompressed ahead of the consumer.
+     */
+    explicit GzipReader(const std::string& fileName, size_t chunkSize = 1 << 20, size_t maxQueuedChunks = 4);
+
+    /**
+     * @brief
+     * Stops decompressing and closes the file.
+     */
+    ~GzipReader();
+
+    GzipReader(const GzipReader&) = delete;
+    GzipReader& operator=(const GzipReader&) = delete;
+
+    /**
+     * @brief
+     * Waits for the next chunk. Returns false once the whole file was read. Throws
+     * std::runtime_error if the file is corrupt or truncated.
+     *
+     * @param[out] chunk            : the next decompressed bytes.
+     */
+    bool next(std::string& chunk);
+
+    /**
+     * @brief
+     * Returns true if the file starts with the gzip magic bytes.
+     *
+     * @param[in] fileName          : the full path to the file.
+     */
+    static bool isGzip(const std::string& fileName);
+
+private:
+    /* Decompression thread: inflates the file chunk by chunk into m_chunks. */
+    void decompress();
+
+    gzFile_s* m_file;
+
+    std::string m_fileName;
+
+    size_t m_chunkSize;
+
+    size_t m_maxQueuedChunks;
+
+    std::mutex m_mutex;
+
+    /* Signaled when a chunk was queued or decompression ended. */
+    std::condition_variable m_chunkReady;
+
+    /* Signaled when a chunk was taken or the reader is stopping. */
+    std::condition_variable m_slotFree;
+
+    std::deque<std::string> m_chunks;
+
+    /* True once the decompression thread has queued its last chunk. */
+    bool m_done;
+
+    /* True if the consumer is gone and decompression should stop. */
+    bool m_stop;
+
+    /* Decompression error, reported by next(). */
+    std::string m_error;
+
+    std::thread m_thread;
+};
@@ -0,0 +1,159 @@
+/*******************************************************************************
+ *
+ * @file labelTable.hpp
+ *
+ ******************************************************************************/
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief
+ * Column-oriented view of the label CSV of a trace (a header line with field names, then one
+ * line per frame). Gzip-compressed files (.csv.gz) are read transparently: they are inflated
+ * on a separate thread and parsed chunk by chunk as they are decompressed. Only the requested
+ * fields are materialized: numeric fields (as reported by projMetaData::isFieldNumeric)
+ * become double columns with NaN for empty cells, all other fields become columns of IDs
+ * into a per-field dictionary of distinct values.
+ *
+ * A selective load takes the use count of every frame and only converts the rows that are
+ * used; if at least a quarter of the rows is unused, the other rows are skipped with a
+ * newline scan. Unused rows hold empty values (NaN or "") either way.
+ */
+class LabelTable
+{
+public:
+    /**
+     * @brief
+     * Loads the given fields of a label file.
+     *
+     * @param[in] fileName      : the full path to the label CSV file.
+     * @param[in] fieldNames    : the fields to load; each must be present in the header.
+     */
+    LabelTable(const std::string& fileName, const std::vector<std::string>& fieldNames);
+
+    /**
+     * @brief
+     * Loads the given fields of the rows with a nonzero use count. Rows are still numbered as
+     * in the file; unused rows hold empty values. Throws std::invalid_argument if the file
+     * does not have one row per use count.
+     *
+     * @param[in] fileName      : the full path to the label CSV file.
+     * @param[in] fieldNames    : the fields to load; each must be present in the header.
+     * @param[in] rowUseCounts  : the number of poses to generate per frame.
+     */
+    LabelTable(const std::string& fileName,
+               const std::vector<std::string>& fieldNames,
+               const std::vector<uint32_t>& rowUseCounts);
+
+    /**
+     * @brief
+     * Returns the number of frames (non-blank data lines) of a label file without parsing it:
+     * the file is memory-mapped (streamed if gzip-compressed) and only its newlines are
+     * counted. Agrees with getNumRows() of a full load, so it can validate inputs and size
+     * buffers before loading labels.
+     *
+     * @param[in] fileName      : the full path to the label CSV file.
+     */
+    static uint32_t countRows(const std::string& fileName);
+
+    /**
+     * @brief
+     * Returns the number of frames (data lines) in the file.
+     */
+    uint32_t getNumRows() const;
+
+    /**
+     * @brief
+     * Returns true if the field was loaded as a numeric column.
+     */
+    bool isNumeric(const std::string& fieldName) const;
+
+    /**
+     * @brief
+     * Returns the values of a numeric field, one per row.
+     */
+    const std::vector<double>& getNumericColumn(const std::string& fieldName) const;
+
+    /**
+     * @brief
+     * Returns the dictionary IDs of a string field, one per row.
+     */
+    const std::vector<uint32_t>& getStringColumn(const std::string& fieldName) const;
+
+    /**
+     * @brief
+     * Returns the distinct values of a string field, indexed by dictionary ID.
+     */
+    const std::vector<std::string>& getDictionary(const std::string& fieldName) const;
+
+private:
+    /* One loaded field. */
+    struct column
+    {
+        bool numeric;
+        std::vector<double> numbers;
+        std::vector<uint32_t> ids;
+        std::vector<std::string> dictionary;
+        std::unordered_map<std::string, uint32_t> lookup;
+    };
+
+    /* Returns the column of a field or throws if the field was not loaded. */
+    const column& getColumn(const std::string& fieldName) const;
+
+    /* A cell: [begin, end) offsets into the file content. */
+    using cellSpan = std::pair<uint64_t, uint64_t>;
+
+    /* Returns the content of a label file. */
+    static std::string readFile(const std::string& fileName);
+
+    /* Parser state carried across the chunks of a streamed file. */
+    struct parseState
+    {
+        const std::vector<std::string>& fieldNames;
+        /* Use count per row, or null to load every row. */
+        const std::vector<uint32_t>* rowUseCounts;
+        /* Skip unused lines with a line index instead of splitting them into cells. */
+        bool skipLines;
+        bool haveHeader;
+        /* Header position and column of every requested field. */
+        std::vector<std::pair<size_t, column*>> targets;
+        std::vector<cellSpan> spans;
+    };
+
+    /* Reads and parses the label file, streaming it if it is gzip-compressed. */
+    void load(const std::vector<std::string>& fieldNames,
+              const std::vector<uint32_t>* rowUseCounts,
+              bool skipLines);
+
+    /* Parses a chunk of complete lines (the first chunk starts with the header). */
+    void parseLines(const char* data, uint64_t end, parseState& state);
+
+    /* Returns true if a line consisting of this single cell is blank. */
+    static bool isBlankCell(const char* data, const cellSpan& span);
+
+    /* Splits the line starting at lineBegin into cell spans, consuming its structurals from
+       next on, and returns the offset of its end. If linesOnly, the structurals are newlines
+       only and the line's cells are indexed on the fly. */
+    static uint64_t splitLine(const char* data,
+                              uint64_t end,
+                              const std::vector<uint64_t>& structurals,
+                              size_t& next,
+                              uint64_t lineBegin,
+                              bool linesOnly,
+                              std::vector<cellSpan>& spans);
+
+    /* Appends one cell value to a column. */
+    static void appendCell(column& col, const std::string& value);
+
+    std::unordered_map<std::string, column> m_columns;
+
+    uint32_t m_numRows;
+
+    /* File name, kept for error messages. */
+    std::string m_fileName;
+};
@@ -0,0 +1,121 @@
+/*******************************************************************************
+ *
+ * @file poseEnsemble.hpp
+ *
+ ******************************************************************************/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <augmenter.hpp>
+
+/**
+ * @brief
+ * Pose sets of an ensemble of seeds (see PoseGenerator::generateEnsemble), kept as flat
+ * value arrays instead of Augmenter::Pose objects, so that generating K sets does not
+ * allocate K times the angle maps of every pose. Poses are built on access, one at a time
+ * or as a whole set.
+ *
+ * All sets have the same slots: slot i is the i-th pose of the frame-by-frame generation
+ * order, with one srcFrame and flip state for all sets. Values are stored as delivered
+ * (flipped poses with negated shift and rotation), slot by slot and within a slot field by
+ * field, each field with one entry per set: shift, rotation, forward, then yaw, pitch and
+ * roll of every sensor. Every set has its own delivery order of the slots.
+ */
+class PoseEnsemble
+{
+public:
+    /**
+     * @brief
+     * Creates an ensemble without sets.
+     */
+    PoseEnsemble();
+
+    /**
+     * @brief
+     * Creates an ensemble from its slots, values and delivery orders. Throws
+     * std::invalid_argument if the sizes do not fit together.
+     *
+     * @param[in] sensorNames   : the sensors of the angle values.
+     * @param[in] numSets       : the number of sets.
+     * @param[in] srcFrames     : the source frame of every slot.
+     * @param[in] flips         : the flip state of every slot.
+     * @param[in] values        : numSets values of every field of every slot, see above.
+     * @param[in] orders        : the slots of every set in delivery order, set after set.
+     */
+    PoseEnsemble(std::vector<std::string> sensorNames,
+                 size_t numSets,
+                 std::vector<uint32_t> srcFrames,
+                 std::vector<uint8_t> flips,
+                 std::vector<float> values,
+                 std::vector<uint32_t> orders);
+
+    /**
+     * @brief
+     * Returns the number of sets.
+     */
+    size_t size() const;
+
+    /**
+     * @brief
+     * Returns the number of poses of every set.
+     */
+    size_t getNumPoses() const;
+
+    /**
+     * @brief
+     * Returns the sensors of the angle maps of the poses.
+     */
+    const std::vector<std::string>& getSensorNames() const;
+
+    /**
+     * @brief
+     * Returns a pose of a set.
+     *
+     * @param[in] set           : the index of the set.
+     * @param[in] index         : the index of the pose in delivery order.
+     */
+    Augmenter::Pose getPose(size_t set, size_t index) const;
+
+    /**
+     * @brief
+     * Overwrites a pose with a pose of a set. Angle map entries of the sensors are assigned
+     * in place, so filling the same pose object again allocates nothing.
+     *
+     * @param[in] set           : the index of the set.
+     * @param[in] index         : the index of the pose in delivery order.
+     * @param[out] pose         : the pose to overwrite.
+     */
+    void getPose(size_t set, size_t index, Augmenter::Pose& pose) const;
+
+    /**
+     * @brief
+     * Returns all poses of a set in delivery order.
+     *
+     * @param[in] set           : the index of the set.
+     */
+    std::vector<Augmenter::Pose> getPoses(size_t set) const;
+
+private:
+    /* Sensors of the angle values. */
+    std::vector<std::string> m_sensorNames;
+
+    /* Number of sets. */
+    size_t m_numSets;
+
+    /* Values per set of every slot: 3 + 3 * number of sensors. */
+    size_t m_numFields;
+
+    /* Source frame and flip state of every slot. */
+    std::vector<uint32_t> m_srcFrames;
+    std::vector<uint8_t> m_flips;
+
+    /* Values of every slot, field and set. */
+    std::vector<float> m_values;
+
+    /* Slots of every set in delivery order, set after set. */
+    std::vector<uint32_t> m_orders;
+};
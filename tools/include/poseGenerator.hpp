@@ -5,10 +5,21 @@
  ******************************************************************************/
 #pragma once
 
-#include <chrono> // for chrono::system_clock
+#include <array>    // for array
+#include <chrono>   // for chrono::system_clock
+#include <cstdint>  // for UINT32_MAX
+#include <optional> // for optional
 #include <augmenter.hpp>
 #include <projmeta/projmetadata.hpp>
 
+#include "ensembleRandom.hpp"
+#include "labelTable.hpp"
+#include "poseEnsemble.hpp"
+#include "poseStatistics.hpp"
+#include "poseValidity.hpp"
+#include "ruleSet.hpp"
+#include "sensorRotations.hpp"
+
 using std::string;
 using std::vector;
 
@@ -50,16 +61,63 @@ public:
         bool flip;
     };
 
+    /**
+     * @brief
+     * How generateShuffledPoses orders the poses it returns.
+     */
+    enum DeliveryMode
+    {
+        /* Every pose is shuffled on its own (default). */
+        ShufflePoses,
+        /* The poses of a frame stay together, back to back, and frames are shuffled as
+         * groups, so the Augmenter decodes every frame once. Every group starts with an
+         * unflipped pose. */
+        ShuffleFrameGroups,
+        /* Needs a GOP index (setGopIndex). The poses of every GOP are shuffled and cut into
+         * blocks of at most maxBlockPoses poses; blocks are shuffled and delivered in
+         * ascending frame order, so a block costs at most one seek plus a forward decode.
+         * maxBlockPoses trades decode cost against randomness: 1 shuffles single poses. */
+        ShuffleGopBlocks,
+        /* Poses are grouped into strata by rule and flip state, each stratum is shuffled,
+         * and the strata are interleaved so that every window of consecutive poses holds
+         * every stratum in its overall proportion (within about one pose per stratum), so
+         * mini-batches get a stable rule mix. Runs in O(n). */
+        ShuffleStrata
+    };
+
+    /**
+     * @brief
+     * Frame decode counts of the poses returned by the last generateShuffledPoses call,
+     * assuming the Augmenter decodes a frame once per run of consecutive poses of that frame.
+     */
+    struct deliveryStatistics
+    {
+        /* Number of poses delivered. */
+        uint64_t numPoses;
+        /* Number of runs of consecutive poses with the same srcFrame, i.e. frame decodes. */
+        uint64_t numDecodes;
+        /* Number of frames with at least one pose, i.e. the fewest decodes possible. */
+        uint64_t numFrames;
+        /* Frames decoded by a sequential decoder, see computeDecodeCost() (zero without a
+         * GOP index). */
+        uint64_t decodeCost;
+    };
+
+    /* Next use of a pose whose frame is not needed again, see computeNextUse(). */
+    static constexpr uint32_t kNoReuse = UINT32_MAX;
+
     /**
      * @brief
      * Constructor for the PoseGenerator that takes in perturbation rules and sensor names
-     * as input.
+     * as input. Rule labels are conjunctions of string label equalities ("road_type=highway")
+     * and numeric label ranges ("speed>=20", "curvature in (0.01, 0.1]"), see RuleSet.
      *
      * @param[in] configRules   : a vector of label-parameters pairs from config.
      * @param[in] sensorNames   : a vector of sensor names from config.
+     * @param[in] seed          : the seed of the random generator, used in full 64 bits.
      */
     PoseGenerator(const std::vector<std::pair<std::string, perturbParams>>& configRules,
-                  std::vector<std::string> sensorNames, unsigned int seed);
+                  std::vector<std::string> sensorNames, uint64_t seed);
 
     /**
      * @brief
@@ -74,6 +132,132 @@ public:
         std::vector<uint32_t> vecUseCounts,
         const std::string& labelsFileName);
 
+    /**
+     * @brief
+     * Same as above, and also returns the next use of every returned pose, see
+     * computeNextUse(). A decoded-frame cache can use it to evict the frame needed furthest
+     * in the future (Belady's optimal policy) instead of the least recently used one.
+     *
+     * @param[in] vecUseCounts  : a vector of the number of poses to generate per frame
+     * @param[in] labelsFileName: the full path to a CSV file that contains (sensor and
+     *                            semantic) video labels for each frame.
+     * @param[out] nextUse      : the next use of every returned pose.
+     */
+    std::vector<Augmenter::Pose> generateShuffledPoses(
+        std::vector<uint32_t> vecUseCounts,
+        const std::string& labelsFileName,
+        std::vector<uint32_t>& nextUse);
+
+    /**
+     * @brief
+     * Generates numEpochs independent pose sets in one pass, each drawn and ordered like a
+     * generateShuffledPoses call. Labels are loaded and rules resolved only once, so every
+     * epoch after the first costs only drawing and ordering its poses. Optional outputs
+     * (delivery statistics, sensor rotations, lattice keys) describe the last epoch;
+     * statistics, if enabled, summarize all epochs.
+     *
+     * @param[in] vecUseCounts  : a vector of the number of poses to generate per frame
+     * @param[in] labelsFileName: the full path to a CSV file that contains (sensor and
+     *                            semantic) video labels for each frame.
+     * @param[in] numEpochs     : the number of epochs to generate.
+     */
+    std::vector<std::vector<Augmenter::Pose>> generateEpochs(const std::vector<uint32_t>& vecUseCounts,
+                                                             const std::string& labelsFileName,
+                                                             uint32_t numEpochs);
+
+    /**
+     * @brief
+     * Generates one pose set per seed, e.g. for the runs of a hyperparameter sweep that share
+     * rules and traces. Labels are loaded and rules resolved once for all seeds, and the
+     * values of all sets are drawn together, slot by slot, from an EnsembleRandom with one
+     * SIMD lane per seed; the validity model and lattice mode apply per lane. Every set is
+     * then ordered by the delivery mode with a std::mt19937_64 of its own seed. A set only
+     * depends on its own seed, not on the other seeds of the ensemble, but differs from what
+     * a PoseGenerator constructed with that seed returns (see EnsembleRandom).
+     *
+     * Sets are returned as a PoseEnsemble, which builds the angle maps of a pose only when
+     * it is read. This PoseGenerator's random stream, statistics and the outputs of
+     * generateShuffledPoses (delivery statistics, sensor rotations, lattice keys) are left
+     * untouched; the delivery statistics of every set are returned by
+     * getEnsembleDeliveryStatistics(), and lattice keys and sensor rotations of a set can be
+     * computed from its poses (computeLatticeKey(), SensorRotations).
+     *
+     * @param[in] vecUseCounts  : a vector of the number of poses to generate per frame
+     * @param[in] labelsFileName: the full path to a CSV file that contains (sensor and
+     *                            semantic) video labels for each frame.
+     * @param[in] seeds         : the seed of every pose set.
+     */
+    PoseEnsemble generateEnsemble(const std::vector<uint32_t>& vecUseCounts,
+                                  const std::string& labelsFileName,
+                                  const std::vector<uint64_t>& seeds);
+
+    /**
+     * @brief
+     * Returns the decode statistics of every set of the last generateEnsemble call, in the
+     * order of its seeds (empty before the first call).
+     */
+    const std::vector<deliveryStatistics>& getEnsembleDeliveryStatistics() const;
+
+    /**
+     * @brief
+     * Returns, for every pose of an order, the index of the next pose with the same srcFrame
+     * (its reuse distance is the difference of the indices), or kNoReuse if the frame is not
+     * needed again. Runs in one backward pass over the poses.
+     *
+     * @param[in] poses         : poses in delivery order.
+     */
+    static std::vector<uint32_t> computeNextUse(const std::vector<Augmenter::Pose>& poses);
+
+    /**
+     * @brief
+     * Sets how generateShuffledPoses orders poses, see DeliveryMode.
+     *
+     * @param[in] mode          : the delivery mode.
+     * @param[in] maxBlockPoses : the most poses per block in ShuffleGopBlocks mode.
+     */
+    void setDeliveryMode(DeliveryMode mode, uint32_t maxBlockPoses = 16);
+
+    /**
+     * @brief
+     * Sets the GOP index of the traces to generate poses for: the keyframe offset of every
+     * frame, i.e. its distance in frames to the keyframe it is decoded from (0 for
+     * keyframes). Enables decode cost statistics and the ShuffleGopBlocks mode; the index
+     * must have one entry per frame of the use counts passed to generateShuffledPoses.
+     * Throws std::invalid_argument if an offset points before the first frame.
+     *
+     * @param[in] keyframeOffsets: the keyframe offset of every frame.
+     */
+    void setGopIndex(const std::vector<uint32_t>& keyframeOffsets);
+
+    /**
+     * @brief
+     * Loads a GOP index from a file with one keyframe offset per line, in frame order. Blank
+     * lines and lines starting with '#' are ignored.
+     *
+     * @param[in] gopIndexFileName: the full path to the keyframe offset file.
+     */
+    void setGopIndex(const std::string& gopIndexFileName);
+
+    /**
+     * @brief
+     * Returns the number of frames a sequential decoder decodes to deliver poses in the given
+     * order. A frame is free if it was the last one decoded, costs the distance from the last
+     * decoded frame if that one is earlier in the same GOP, and costs its keyframe offset + 1
+     * otherwise (seek to the keyframe and decode forward).
+     *
+     * @param[in] poses         : poses in delivery order.
+     * @param[in] keyframeOffsets: the keyframe offset of every frame.
+     */
+    static uint64_t computeDecodeCost(const std::vector<Augmenter::Pose>& poses,
+                                      const std::vector<uint32_t>& keyframeOffsets);
+
+    /**
+     * @brief
+     * Returns the decode statistics of the poses returned by the last generateShuffledPoses
+     * call (all zero before the first call).
+     */
+    const deliveryStatistics& getDeliveryStatistics() const;
+
     /**
      * @brief
      * Returns a vector of vectors of Poses that matches the passed vecUseCounts vector
@@ -87,12 +271,51 @@ public:
         std::vector<uint32_t> vecUseCounts,
         const std::string& labelsFileName);
 
+    /**
+     * @brief
+     * Sets the perturbation parameters used for frames that match no rule. Without a
+     * fallback rule, generation fails upfront if any frame with a nonzero use count is not
+     * covered by a rule. Resets statistics if they are enabled.
+     *
+     * @param[in] params        : parameters for frames no rule applies to.
+     */
+    void setFallbackRule(const perturbParams& params);
+
+    /**
+     * @brief
+     * Returns the ranges of frames that have a nonzero use count but match no rule (and would
+     * use the fallback rule if one is set), without generating any pose.
+     *
+     * @param[in] vecUseCounts  : a vector of the number of poses to generate per frame
+     * @param[in] labelsFileName: the full path to a CSV file that contains (sensor and
+     *                            semantic) video labels for each frame.
+     */
+    std::vector<RuleSet::frameRange> findUncoveredFrames(
+        const std::vector<uint32_t>& vecUseCounts,
+        const std::string& labelsFileName) const;
+
     /**
      * @brief
      * Returns a vector of Pose for a given frame.
      *
      * @param[in] useCount      : the number of poses to generate per frame
      * @param[in] index         : the frame number to generate poses
+     * @param[in] labels        : labels of the trace, loaded with (at least) the fields
+     *                            referenced by the rules.
+     */
+    std::vector<Augmenter::Pose> generatePoses4oneFrame(
+        uint32_t useCount,
+        uint32_t index,
+        const LabelTable& labels);
+
+    /**
+     * @brief
+     * Returns a vector of Pose for a given frame. Rules are checked with doLabelsMatch(), so
+     * they may only use string equalities (key=value); other conditions throw
+     * std::invalid_argument, use the LabelTable overload for them.
+     *
+     * @param[in] useCount      : the number of poses to generate per frame
+     * @param[in] index         : the frame number to generate poses
      * @param[in] trace         : a projMetaTrace class which allows to use doLabelsMatch()
      *                            and getNumDatapoints().
      */
@@ -109,21 +332,270 @@ public:
      */
     Augmenter::Pose generateOnePose(const perturbParams& params);
 
+    /**
+     * @brief
+     * Enables or disables streaming statistics of generated poses (per rule and per field).
+     * Enabling starts from empty summaries; disabling discards them.
+     *
+     * @param[in] enable        : true to collect statistics during generation.
+     */
+    void enableStatistics(bool enable);
+
+    /**
+     * @brief
+     * Returns the statistics collected so far, or nullptr if statistics are disabled.
+     */
+    const PoseStatistics* getStatistics() const;
+
+    /**
+     * @brief
+     * Enables or disables the batched sensor rotation output. When enabled, every call of
+     * generateShuffledPoses or generatePoses4vecFrames also computes the rotation matrix of
+     * every (pose, sensor), see SensorRotations, in the order the poses are returned
+     * (frame by frame for generatePoses4vecFrames).
+     *
+     * @param[in] enable        : true to compute rotations during generation.
+     */
+    void enableSensorRotations(bool enable);
+
+    /**
+     * @brief
+     * Returns the sensor rotations of the poses returned by the last generation call, or
+     * nullptr if the output is disabled.
+     */
+    const SensorRotations* getSensorRotations() const;
+
+    /**
+     * @brief
+     * Enables or disables lattice mode. In lattice mode every value of a generated pose
+     * (shift, rotation, forward and the sensor angles) is one of the 2 * stepsPerSide + 1
+     * points k * max / stepsPerSide of its rule's bound (-max, max). A point is drawn with the
+     * probability the rule's distribution gives to its cell, the values within half a step of
+     * it, so the lattice keeps the distribution up to the grid resolution. Poses that share a
+     * lattice cell are identical, and the Augmenter can reuse their warp maps, see
+     * getLatticeKeys(). generateOnePose() is not affected.
+     *
+     * @param[in] stepsPerSide  : grid points on each side of zero, 0 to disable lattice mode.
+     */
+    void setLatticeMode(uint32_t stepsPerSide);
+
+    /**
+     * @brief
+     * Returns the lattice cell key of every pose returned by the last generation call, in the
+     * order the poses are returned (frame by frame for generatePoses4vecFrames), or an empty
+     * vector outside lattice mode. See computeLatticeKey().
+     */
+    const std::vector<uint64_t>& getLatticeKeys() const;
+
+    /**
+     * @brief
+     * Returns a 64-bit FNV-1a hash of all values of a pose, including flip and the sensor
+     * names. It only depends on the pose, so it is stable across runs and processes and can
+     * key a persistent warp-map cache; on lattice poses, equal keys mean equal cells.
+     *
+     * @param[in] pose          : the pose to hash.
+     */
+    static uint64_t computeLatticeKey(const Augmenter::Pose& pose);
+
+    /**
+     * @brief
+     * Sets the per-sensor validity model checked during generation, see PoseValidity. Every
+     * generated pose whose crop leaves the valid image region of a modeled sensor, checked
+     * with the values it is delivered with (after flipping), is resampled from its rule right
+     * away, so no decode is spent on it; the delivered poses
+     * then follow the rule's distribution restricted to valid poses. Generation throws if a
+     * frame still has invalid poses after many resampling rounds. A model without sensors
+     * disables the check.
+     *
+     * @param[in] validity      : the sensor models.
+     */
+    void setValidityModel(const PoseValidity& validity);
+
+    /**
+     * @brief
+     * Returns the number of poses rejected by the validity model and resampled so far.
+     */
+    uint64_t getNumRejectedPoses() const;
+
+    /**
+     * @brief
+     * Returns a compact report of the statistics collected since the last report and starts
+     * new summaries for the next epoch. Returns an empty string if statistics are disabled.
+     *
+     * @param[in] epoch         : epoch number written into the report.
+     */
+    std::string reportStatistics(uint32_t epoch);
+
 private:
-    /* Perturbation Rule which is a vector of map-perturbParams pairs. */
-    std::vector<std::pair<std::map<std::string, std::string>, perturbParams>> m_perturbRules;
+    /* Compiled label conditions of the perturbation rules, in first-match order. */
+    RuleSet m_ruleSet;
+
+    /* Perturbation parameters of each rule, indexed like m_ruleSet, followed by the
+     * parameters of the fallback rule if one is set. */
+    std::vector<perturbParams> m_ruleParams;
+
+    /* Streaming statistics of generated poses, present only if enabled. */
+    std::optional<PoseStatistics> m_statistics;
+
+    /* Sensor rotations of the last generated poses, present only if enabled. */
+    std::optional<SensorRotations> m_sensorRotations;
 
     /* Vector that specifies sensor names. */
     std::vector<std::string> m_sensorNames;
 
+    /* Order of the poses returned by generateShuffledPoses. */
+    DeliveryMode m_deliveryMode;
+
+    /* Decode statistics of the last generateShuffledPoses call. */
+    deliveryStatistics m_deliveryStatistics;
+
+    /* Most poses per block in ShuffleGopBlocks mode. */
+    uint32_t m_maxBlockPoses;
+
+    /* Keyframe offset of every frame, empty without a GOP index. */
+    std::vector<uint32_t> m_keyframeOffsets;
+
+    /* Sensor models the generated poses are checked against, present only if set. */
+    std::optional<PoseValidity> m_validity;
+
+    /* Number of poses rejected by the validity model. */
+    uint64_t m_numRejectedPoses;
+
+    /* Grid points of one field of a rule and their cumulative probabilities. */
+    struct latticeAxis
+    {
+        std::vector<float> values;
+        std::vector<double> cumulative;
+    };
+
+    /* Grid points on each side of zero in lattice mode, 0 if lattice mode is off. */
+    uint32_t m_latticeSteps;
+
+    /* Lattice axes of every rule, indexed like m_ruleParams, and of every PoseStatistics field. */
+    std::vector<std::array<latticeAxis, PoseStatistics::NumFields>> m_latticeAxes;
+
+    /* Lattice cell keys of the last generated poses, empty outside lattice mode. */
+    std::vector<uint64_t> m_latticeKeys;
+
+    /* Builds the lattice axes of all rules for m_latticeSteps. */
+    void buildLattice();
+
+    /* Builds the lattice axis of one field from its random parameters. */
+    latticeAxis buildLatticeAxis(const randParams& params) const;
+
+    /* Draws a grid point of a lattice axis. */
+    float getLatticeRandom(const latticeAxis& axis, std::mt19937_64& generator);
+
+    /* Generates a lattice pose from the lattice axes of a rule. */
+    Augmenter::Pose generateLatticePose(int32_t rule, std::mt19937_64& generator);
+
+    /* Computes the optional outputs (sensor rotations, lattice keys) of returned poses. */
+    void computePoseOutputs(const std::vector<Augmenter::Pose>& poses);
+
+    /* Orders poses (or pose slots) in GOP blocks, see ShuffleGopBlocks. */
+    template <typename PoseT>
+    std::vector<PoseT> orderGopBlocks(const std::vector<std::vector<PoseT>>& framePoses,
+                                      std::mt19937_64& generator);
+
+    /* Returns the index of the fallback rule in m_ruleParams, or RuleSet::kNoRule. */
+    int32_t getFallbackRule() const;
+
+    /* Loads the labels of a trace and resolves the rule of every frame, using the fallback
+     * rule where no rule matches. Throws, before any pose is generated, if the trace length
+     * does not match vecUseCounts or if frames with nonzero use counts are not covered. */
+    std::vector<int32_t> resolveFrameRules(const std::vector<uint32_t>& vecUseCounts,
+                                           const std::string& labelsFileName) const;
+
+    /* Orders the poses of all frames by the delivery mode, drawing from generator, and
+     * computes delivery statistics and the optional outputs of the order. */
+    std::vector<Augmenter::Pose> orderPoses(std::vector<std::vector<Augmenter::Pose>>& unshuffledPoses,
+                                            const std::vector<int32_t>& frameRules,
+                                            std::mt19937_64& generator);
+
+    /* Orders the poses (or pose slots) of all frames by the delivery mode, drawing from
+     * generator; only srcFrame and flip of the elements are used. */
+    template <typename PoseT>
+    std::vector<PoseT> orderByMode(std::vector<std::vector<PoseT>>& unshuffledPoses,
+                                   const std::vector<int32_t>& frameRules,
+                                   std::mt19937_64& generator);
+
+    /* Returns the delivery statistics of poses (or pose slots) in delivery order. */
+    template <typename PoseT>
+    deliveryStatistics computeDeliveryStatistics(const std::vector<PoseT>& orderedPoses,
+                                                 const std::vector<std::vector<PoseT>>& framePoses) const;
+
+    /* Orders poses (or pose slots) by strata, see ShuffleStrata. */
+    template <typename PoseT>
+    std::vector<PoseT> orderStrata(std::vector<std::vector<PoseT>>& framePoses,
+                                   const std::vector<int32_t>& frameRules,
+                                   std::mt19937_64& generator);
+
+    /* A pose of an ensemble set, ordered by the delivery mode in place of the pose: its
+     * frame and flip state, and its slot in the PoseEnsemble. */
+    struct poseSlot
+    {
+        uint32_t srcFrame;
+        bool flip;
+        uint32_t slot;
+    };
+
+    /* Decode statistics of every set of the last generateEnsemble call. */
+    std::vector<deliveryStatistics> m_ensembleStatistics;
+
+    /* Draws one field of a rule (a PoseStatistics field) for the active lanes of an ensemble
+     * into values, one entry per lane; uniforms is scratch space with one entry per lane. */
+    void drawEnsembleField(EnsembleRandom& random,
+                           int32_t rule,
+                           uint32_t field,
+                           const randParams& params,
+                           const uint8_t* active,
+                           std::vector<double>& uniforms,
+                           float* values);
+
+    /* Draws the values of a pose slot of a rule for the active lanes of an ensemble, in the
+     * field order of PoseEnsemble, and negates shift and rotation of a flipped slot. */
+    void drawEnsemblePoses(EnsembleRandom& random,
+                           int32_t rule,
+                           bool flip,
+                           const uint8_t* active,
+                           std::vector<double>& uniforms,
+                           float* values);
+
+    /* Resolves rules and generates the poses of every frame (generatePoses4vecFrames without
+     * the optional outputs); also returns the rule of every frame. */
+    std::vector<std::vector<Augmenter::Pose>> generateFramePoses(const std::vector<uint32_t>& vecUseCounts,
+                                                                 const std::string& labelsFileName,
+                                                                 std::vector<int32_t>& frameRules);
+
+    /* Generates the poses of every frame from the resolved frame rules, drawing from
+     * generator. */
+    std::vector<std::vector<Augmenter::Pose>> generateRulePoses(const std::vector<uint32_t>& vecUseCounts,
+                                                                const std::vector<int32_t>& frameRules,
+                                                                std::mt19937_64& generator);
+
+    /* Generates useCount poses for a frame from the given rule (RuleSet::kNoRule throws). */
+    std::vector<Augmenter::Pose> generatePoses4rule(uint32_t useCount,
+                                                    uint32_t index,
+                                                    int32_t rule,
+                                                    std::mt19937_64& generator);
+
+    /* Resamples the invalid poses of a frame from its rule until all are valid. */
+    void resampleInvalidPoses(std::vector<Augmenter::Pose>& poses,
+                              uint32_t index,
+                              int32_t rule,
+                              std::mt19937_64& generator);
+
+    /* Generates a pose as generateOnePose(params), drawing from generator. */
+    Augmenter::Pose generateOnePose(const perturbParams& params, std::mt19937_64& generator);
+
     /* Generate a random number by selecting a correct random number generator */
-    float getRandom(const randParams& rParams);
+    float getRandom(const randParams& rParams, std::mt19937_64& generator);
 
     /* Gaussian random number generator */
-    float genGaussianRV(const randParams& params);
+    float genGaussianRV(const randParams& params, std::mt19937_64& generator);
 
     /* Uniform random number generator */
-    float genUniformRV(const randParams& params);
+    float genUniformRV(const randParams& params, std::mt19937_64& generator);
 
     /* Random generator */
     std::mt19937_64 m_generator;
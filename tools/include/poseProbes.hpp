@@ -0,0 +1,59 @@
+/*******************************************************************************
+ *
+ * @file poseProbes.hpp
+ *
+ ******************************************************************************/
+#pragma once
+
+#include <chrono>  // for chrono::steady_clock
+#include <cstdint> // for uint64_t
+
+/**
+ * @brief
+ * Statically-defined tracepoints (USDT) for the pose generation hot path, provider "posegen".
+ * Probes are compiled in only when POSEGEN_ENABLE_USDT is defined (CMake option of the same
+ * name) and <sys/sdt.h> is available; otherwise every probe and timestamp compiles to nothing.
+ * A compiled-in probe is a single nop until a tracer attaches, e.g.
+ *
+ *     bpftrace -e 'usdt:./libprojPoseGenerator.so:posegen:frame_generated
+ *                  { @ns = hist(arg2); }'
+ *
+ * Probes (arguments in order):
+ *   trace_load_start(numFrames)
+ *   trace_load_end(numFrames, durationNs)
+ *   rule_resolved(frameIndex, ruleIndex)
+ *   frame_generated(frameIndex, useCount, durationNs)
+ *   gaussian_retry(retries)                         only fired when retries > 0
+ *   shuffle_start(numPoses)
+ *   reshuffle_retry(attempt, numPoses)
+ *   shuffle_end(numPoses, durationNs, reshuffles)
+ */
+#if defined(POSEGEN_ENABLE_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define POSEGEN_PROBES_ENABLED 1
+#endif
+#endif
+
+#if defined(POSEGEN_PROBES_ENABLED)
+#define POSEGEN_PROBE1(name, a1) DTRACE_PROBE1(posegen, name, a1)
+#define POSEGEN_PROBE2(name, a1, a2) DTRACE_PROBE2(posegen, name, a1, a2)
+#define POSEGEN_PROBE3(name, a1, a2, a3) DTRACE_PROBE3(posegen, name, a1, a2, a3)
+#else
+#define POSEGEN_PROBES_ENABLED 0
+#define POSEGEN_PROBE1(name, a1) ((void)0)
+#define POSEGEN_PROBE2(name, a1, a2) ((void)0)
+#define POSEGEN_PROBE3(name, a1, a2, a3) ((void)0)
+#endif
+
+/* Monotonic timestamp in nanoseconds for probe durations; 0 when probes are compiled out. */
+inline uint64_t poseProbeTimestamp()
+{
+#if POSEGEN_PROBES_ENABLED
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+#else
+    return 0;
+#endif
+}
@@ -0,0 +1,158 @@
+/*******************************************************************************
+ *
+ * @file poseStatistics.hpp
+ *
+ ******************************************************************************/
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <augmenter.hpp>
+
+/**
+ * @brief
+ * Streaming summary of generated poses, kept per rule and per pose field. It allows checking
+ * that poses follow the configured randParams without storing them: for every field it tracks
+ * count, mean and variance (Welford), min/max and a fixed-bin histogram over (-max, max), and
+ * for every rule the ratio of flipped poses. Sensor angles are pooled over all sensors.
+ */
+class PoseStatistics
+{
+public:
+    /* Pose fields that are summarized. */
+    enum Field
+    {
+        Shift = 0,
+        Rotation,
+        Forward,
+        SensorYaw,
+        SensorPitch,
+        SensorRoll,
+        NumFields
+    };
+
+    /* Number of histogram bins spanning (-max, max) of a field. */
+    static constexpr uint32_t kNumBins = 16;
+
+    /* Number of samples buffered before they are folded into the running moments. */
+    static constexpr uint32_t kBlockSize = 256;
+
+    /**
+     * @brief
+     * Summary of one field of one rule.
+     */
+    struct fieldSummary
+    {
+        uint64_t count;
+        double mean;
+        double variance;
+        float min;
+        float max;
+        std::array<uint64_t, kNumBins> histogram;
+    };
+
+    /**
+     * @brief
+     * Accumulator for a single field. Samples are buffered into a fixed-size block; a full
+     * block is reduced with branch-free loops (sum, squared deviations, min/max, bin indices)
+     * the compiler can vectorize, then merged into the running moments with Chan's parallel
+     * form of Welford's update.
+     */
+    class fieldAccumulator
+    {
+    public:
+        explicit fieldAccumulator(double limit = 0);
+
+        /* Adds one sample. */
+        void add(float value)
+        {
+            m_block[m_blockCount++] = value;
+            if (m_blockCount == kBlockSize)
+            {
+                flush();
+            }
+        }
+
+        /* Folds buffered samples into the running moments. */
+        void flush();
+
+        /* Returns the summary including samples still buffered. */
+        fieldSummary summary() const;
+
+    private:
+        alignas(32) std::array<float, kBlockSize> m_block;
+        uint32_t m_blockCount;
+        double m_limit;
+        fieldSummary m_summary;
+    };
+
+    /**
+     * @brief
+     * Constructor that takes, per rule, the hard limit (randParams::max) of every field.
+     *
+     * @param[in] limits        : per-rule field limits used as histogram ranges.
+     */
+    explicit PoseStatistics(const std::vector<std::array<double, NumFields>>& limits);
+
+    /**
+     * @brief
+     * Adds a generated pose to the summaries of the given rule.
+     *
+     * @param[in] rule          : index of the rule the pose was generated from.
+     * @param[in] pose          : the generated pose.
+     */
+    void addPose(uint32_t rule, const Augmenter::Pose& pose);
+
+    /**
+     * @brief
+     * Returns the summary of one field of one rule.
+     */
+    fieldSummary summary(uint32_t rule, Field field) const;
+
+    /**
+     * @brief
+     * Returns the number of poses and the ratio of flipped poses of one rule.
+     */
+    uint64_t numPoses(uint32_t rule) const;
+    double flipRatio(uint32_t rule) const;
+
+    /**
+     * @brief
+     * Returns the number of rules being summarized.
+     */
+    uint32_t numRules() const;
+
+    /**
+     * @brief
+     * Returns a compact, line-oriented report of all rules that received poses, e.g.
+     * "epoch=3 rule=0 poses=1200 flip=0.500" followed by one line per field.
+     *
+     * @param[in] epoch         : epoch number written into the report.
+     */
+    std::string report(uint32_t epoch) const;
+
+    /**
+     * @brief
+     * Clears all summaries, e.g. at the start of an epoch.
+     */
+    void reset();
+
+    /* Returns a short name of a field, e.g. "shift". */
+    static const char* fieldName(Field field);
+
+private:
+    /* Per-rule accumulators. */
+    struct ruleStatistics
+    {
+        std::array<fieldAccumulator, NumFields> fields;
+        uint64_t numPoses;
+        uint64_t numFlipped;
+    };
+
+    std::vector<ruleStatistics> m_rules;
+
+    /* Field limits the accumulators were built with, kept for reset(). */
+    std::vector<std::array<double, NumFields>> m_limits;
+};
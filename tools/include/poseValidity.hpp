@@ -0,0 +1,148 @@
+/*******************************************************************************
+ *
+ * @file poseValidity.hpp
+ *
+ ******************************************************************************/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <augmenter.hpp>
+
+/**
+ * @brief
+ * Analytic check whether the output crop of every modeled sensor stays inside the valid
+ * region of its source image after a pose is applied, so that poses the Augmenter would
+ * reject after decoding and warping can be resampled during generation instead.
+ *
+ * Geometry, in the vehicle frame (x forward, y left, z up): the perturbed camera of a sensor
+ * sits at (forward, shift, 0) relative to the source camera and is rotated by
+ * R = Rz(rotation + sensor_yaw) * Ry(sensor_pitch) * Rx(sensor_roll), angles in degrees (the
+ * convention of SensorRotations). The scene is a plane at the model's depth in front of the
+ * perturbed camera. Every crop corner is traced onto that plane and projected into the source
+ * camera; a pose is valid if all four land in front of the source camera and inside its
+ * valid region. Under these assumptions the mapping is a homography, so checking the corners
+ * covers the whole crop. Poses are checked with the values they are delivered with, flipped
+ * ones with their negated shift and rotation, so the valid region need not be symmetric about
+ * the crop center.
+ *
+ * The check runs over structure-of-arrays batches in fixed-size tiles, with branch-free
+ * arithmetic that the compiler vectorizes at -O2 already.
+ */
+class PoseValidity
+{
+public:
+    /* Camera intrinsics and crop bounds of a sensor, in pixels of the source image. */
+    struct sensorModel
+    {
+        /* Focal lengths. */
+        float fx;
+        float fy;
+        /* Principal point; the output crop is centered on it. */
+        float cx;
+        float cy;
+        /* Size of the output crop. */
+        float cropWidth;
+        float cropHeight;
+        /* Valid region of the source image (e.g. inside the image minus a vignetting or
+         * hood mask margin). */
+        float minX;
+        float minY;
+        float maxX;
+        float maxY;
+        /* Distance of the assumed scene plane in meters; turns shift and forward into image
+         * motion. */
+        float depth;
+    };
+
+    /**
+     * @brief
+     * Creates a model without sensors, under which every pose is valid.
+     */
+    PoseValidity();
+
+    /**
+     * @brief
+     * Adds or replaces the model of a sensor. Throws std::invalid_argument if focal lengths,
+     * crop size or depth are not positive, or if the valid region is empty.
+     *
+     * @param[in] sensorName    : the sensor name, as in the pose angle maps.
+     * @param[in] model         : the intrinsics and crop bounds of the sensor.
+     */
+    void setSensorModel(const std::string& sensorName, const sensorModel& model);
+
+    /**
+     * @brief
+     * Returns true if no sensor is modeled.
+     */
+    bool empty() const;
+
+    /**
+     * @brief
+     * Checks a batch of poses against all modeled sensors; sensors missing from a pose get
+     * zero angles.
+     *
+     * @param[in] poses         : the poses to check.
+     * @param[out] valid        : 1 for every valid pose, 0 otherwise.
+     */
+    void check(const std::vector<Augmenter::Pose>& poses, std::vector<uint8_t>& valid) const;
+
+    /**
+     * @brief
+     * Checks a batch of poses given as structure-of-arrays against all modeled sensors;
+     * modeled sensors missing from sensorNames get zero angles.
+     *
+     * @param[in] sensorNames   : the sensors the angles are given for.
+     * @param[in] shift         : the shift of every pose.
+     * @param[in] rotation      : the rotation of every pose.
+     * @param[in] forward       : the forward of every pose.
+     * @param[in] angles        : the yaw, pitch and roll of every sensor, in the order of
+     *                            sensorNames, three arrays of n floats per sensor back to back.
+     * @param[in] n             : the number of poses.
+     * @param[out] valid        : 1 for every valid pose, 0 otherwise.
+     */
+    void check(const std::vector<std::string>& sensorNames,
+               const float* shift,
+               const float* rotation,
+               const float* forward,
+               const float* angles,
+               size_t n,
+               std::vector<uint8_t>& valid) const;
+
+    /**
+     * @brief
+     * Checks one pose against all modeled sensors.
+     *
+     * @param[in] pose          : the pose to check.
+     */
+    bool isValid(const Augmenter::Pose& pose) const;
+
+    /**
+     * @brief
+     * Clears valid[i] for every pose i whose crop leaves the valid region of one sensor.
+     *
+     * @param[in] model         : the sensor model.
+     * @param[in] shift         : the shift of every pose.
+     * @param[in] forward       : the forward of every pose.
+     * @param[in] sines         : sines of the yaw (rotation + sensor yaw), pitch and roll
+     *                            angles, three arrays of n floats back to back.
+     * @param[in] cosines       : cosines of the same angles, laid out alike.
+     * @param[in] n             : the number of poses.
+     * @param[in,out] valid     : the validity of every pose.
+     */
+    static void checkSensor(const sensorModel& model,
+                            const float* shift,
+                            const float* forward,
+                            const float* sines,
+                            const float* cosines,
+                            size_t n,
+                            uint8_t* valid);
+
+private:
+    /* Models of the checked sensors, by sensor name. */
+    std::map<std::string, sensorModel> m_sensorModels;
+};
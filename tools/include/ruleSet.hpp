@@ -0,0 +1,270 @@
+/*******************************************************************************
+ *
+ * @file ruleSet.hpp
+ *
+ ******************************************************************************/
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <projmeta/projmetadata.hpp>
+
+#include "labelTable.hpp"
+
+/**
+ * @brief
+ * Compiled, ordered list of label rules. Each rule is a conjunction of whitespace separated
+ * conditions:
+ *   key=value              string label equals value (numeric labels: equals the number)
+ *   key=a|b|c              label is one of the values
+ *   key!=x  key!=a|b       label is none of the values (empty cells included)
+ *   key=*                  any value; the field must exist in the label file
+ *   key<v  key<=v          numeric label below / at most v
+ *   key>v  key>=v          numeric label above / at least v
+ *   key in [a, b)          numeric label in an interval; each end may be '[' '(' / ']' ')'
+ *
+ * Every referenced field is mapped per frame to a small symbol: string values are interned
+ * against the values the rules mention (0 = any other value), numeric values are replaced by
+ * their bucket in a sorted per-field threshold index built from all numeric conditions of
+ * that field (NaN gets a bucket of its own). Every condition then becomes a bitmask over the
+ * symbols of its field, so checking it is a single bit test, and rules are evaluated
+ * column-wise over whole traces.
+ *
+ * Because every field has a finite symbol space, rules can be analyzed at construction:
+ * rules that can never match (e.g. "speed>40 speed<20") and rules fully shadowed by earlier
+ * rules are dropped from the matcher and reported through getWarnings(). Rule indices
+ * returned by resolve() always refer to the original rule list.
+ *
+ * Distinct symbol tuples are few across a whole dataset, so resolutions are memoized: every
+ * tuple is packed into a 64-bit key and its rule kept in a process-wide memo table that is
+ * shared by all RuleSets compiled from the same rule list. Resolving a frame of any trace is
+ * then one hash probe; rules are evaluated only for tuples never seen before.
+ */
+class RuleSet
+{
+public:
+    /* Returned for frames that match no rule. */
+    static constexpr int32_t kNoRule = -1;
+
+    /* A range of consecutive frames [first, last]. */
+    struct frameRange
+    {
+        uint32_t first;
+        uint32_t last;
+    };
+
+    /**
+     * @brief
+     * Parses, validates and compiles rules. Throws std::invalid_argument on malformed
+     * conditions, numeric comparisons on string labels or invalid string labels.
+     *
+     * @param[in] rules         : rule strings in first-match order.
+     */
+    explicit RuleSet(const std::vector<std::string>& rules);
+
+    /**
+     * @brief
+     * Returns the number of rules, including dropped ones.
+     */
+    uint32_t size() const;
+
+    /**
+     * @brief
+     * Returns the indices of rules dropped because they can never fire.
+     */
+    const std::vector<uint32_t>& getDroppedRules() const;
+
+    /**
+     * @brief
+     * Returns a human-readable warning for every dropped rule.
+     */
+    const std::vector<std::string>& getWarnings() const;
+
+    /**
+     * @brief
+     * Returns true if no two remaining rules can match the same frame, so their evaluation
+     * order does not change results.
+     */
+    bool areRulesDisjoint() const;
+
+    /**
+     * @brief
+     * If the remaining rules are disjoint, accumulates how often each rule was hit in the
+     * given resolution result and reorders evaluation by descending hit count, so that the
+     * most frequent rules are checked first. Does nothing otherwise.
+     *
+     * @param[in] resolved      : the result of resolve() for a trace.
+     */
+    void reorderByHits(const std::vector<int32_t>& resolved);
+
+    /**
+     * @brief
+     * Returns the number of distinct label tuples memoized so far for this rule list.
+     */
+    size_t getMemoSize() const;
+
+    /**
+     * @brief
+     * Returns the label fields referenced by any rule, i.e. the fields to load.
+     */
+    const std::vector<std::string>& getFieldNames() const;
+
+    /**
+     * @brief
+     * Returns, for every row of the table, the index of the first matching rule or kNoRule.
+     *
+     * @param[in] labels        : labels of a trace, with at least getFieldNames() loaded.
+     */
+    std::vector<int32_t> resolve(const LabelTable& labels) const;
+
+    /**
+     * @brief
+     * Returns the index of the first rule matching one row, or kNoRule.
+     *
+     * @param[in] labels        : labels of a trace, with at least getFieldNames() loaded.
+     * @param[in] row           : the row (frame) to resolve.
+     */
+    int32_t resolveRow(const LabelTable& labels, uint32_t row) const;
+
+    /**
+     * @brief
+     * Returns the index of the first rule matching one frame of a projMetaTrace, or kNoRule.
+     * A trace can only check string equalities (key=value), so this throws
+     * std::invalid_argument if a remaining rule has any other condition.
+     *
+     * @param[in] trace         : a projMetaTrace which allows to use doLabelsMatch().
+     * @param[in] row           : the row (frame) to resolve.
+     */
+    int32_t resolveRow(const projMetaData::projMetaTrace& trace, uint32_t row) const;
+
+    /**
+     * @brief
+     * Returns the ranges of frames that need poses (nonzero use count) but match no rule.
+     *
+     * @param[in] resolved      : the result of resolve() for a trace.
+     * @param[in] vecUseCounts  : the number of poses to generate per frame.
+     */
+    static std::vector<frameRange> findUncovered(const std::vector<int32_t>& resolved,
+                                                 const std::vector<uint32_t>& vecUseCounts);
+
+private:
+    /* Bitmask over the symbols of a field. */
+    using symbolMask = std::vector<uint64_t>;
+
+    /* Numeric threshold: values above it are >= value if inclusive, > value otherwise. */
+    struct cut
+    {
+        double value;
+        bool inclusive;
+        bool operator<(const cut& other) const;
+        bool operator==(const cut& other) const;
+    };
+
+    /* A field referenced by the rules and how its values map to symbols. */
+    struct field
+    {
+        std::string name;
+        bool numeric;
+        /* Sorted unique thresholds (numeric fields). */
+        std::vector<cut> cuts;
+        /* Values mentioned by the rules; value i has symbol i + 1 (string fields). */
+        std::vector<std::string> values;
+
+        /* Number of distinct symbols of the field. */
+        uint32_t numSymbols() const;
+    };
+
+    /* A compiled condition: the bit of the field's symbol must be set in mask. */
+    struct condition
+    {
+        uint32_t field;
+        symbolMask mask;
+    };
+
+    /* Returns true if the symbol's bit is set. */
+    static bool testBit(const symbolMask& mask, uint32_t symbol)
+    {
+        return (mask[symbol >> 6] >> (symbol & 63)) & 1;
+    }
+
+    /* A rule of the matcher: its index in the original list and its conditions. */
+    struct compiledRule
+    {
+        uint32_t id;
+        std::vector<condition> conditions;
+        uint64_t hits;
+    };
+
+    /* Memoized tuple key -> rule resolutions, shared process-wide per rule list. */
+    struct memoTable
+    {
+        std::mutex mutex;
+        std::unordered_map<uint64_t, int32_t> rules;
+    };
+
+    /* Returns the memo table shared by all RuleSets compiled from the given rule list. */
+    static std::shared_ptr<memoTable> sharedMemo(const std::vector<std::string>& rules);
+
+    /* Evaluates the rules on one tuple of symbols (one per field). */
+    int32_t resolveSymbols(const std::vector<uint32_t>& symbols) const;
+
+    /* Resolves a tuple key through the memo; the caller holds the memo mutex. */
+    int32_t resolveKey(uint64_t key) const;
+
+    /* Column-wise evaluation of all rules, used when tuples do not fit a 64-bit key. */
+    std::vector<int32_t> resolveColumns(const std::vector<std::vector<uint32_t>>& symbols,
+                                        uint32_t numRows) const;
+
+    /* Returns a mask with all symbols of a field set. */
+    symbolMask fullMask(const field& fieldInfo) const;
+
+    /* Returns, per field, the symbols a rule admits (conditions on a field are ANDed). */
+    std::vector<symbolMask> regionOf(const compiledRule& rule) const;
+
+    /* Drops rules that can never match or are shadowed by earlier rules. */
+    void dropDeadRules(const std::vector<std::string>& rules);
+
+    /* Returns the index of a field in m_fields, adding it if needed. */
+    uint32_t addField(const std::string& name);
+
+    /* Maps every row of the table to its symbol of the given field. */
+    std::vector<uint32_t> symbolize(const LabelTable& labels, const field& fieldInfo) const;
+
+    /* Maps one row of the table to its symbol of the given field. */
+    uint32_t symbolOf(const LabelTable& labels, const field& fieldInfo, uint32_t row) const;
+
+    std::vector<field> m_fields;
+
+    std::vector<std::string> m_fieldNames;
+
+    /* Remaining rules in evaluation order. */
+    std::vector<compiledRule> m_rules;
+
+    /* Number of rules in the original list. */
+    uint32_t m_numRules;
+
+    std::vector<uint32_t> m_droppedRules;
+
+    std::vector<std::string> m_warnings;
+
+    /* Labels of every rule of the original list as doLabelsMatch() takes them, or nullopt
+     * if the rule has conditions other than string equalities. */
+    std::vector<std::optional<std::map<std::string, std::string>>> m_labelMaps;
+
+    bool m_disjoint;
+
+    /* Mixed-radix weights packing one symbol per field into a tuple key. */
+    std::vector<uint64_t> m_strides;
+
+    /* True if every symbol tuple fits a 64-bit key, i.e. resolutions can be memoized. */
+    bool m_memoizable;
+
+    std::shared_ptr<memoTable> m_memo;
+};
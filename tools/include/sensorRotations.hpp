@@ -0,0 +1,142 @@
+/*******************************************************************************
+ *
+ * @file sensorRotations.hpp
+ *
+ ******************************************************************************/
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib> // for aligned_alloc(), free()
+#include <new>     // for bad_alloc
+#include <string>
+#include <vector>
+
+#include <augmenter.hpp>
+
+/**
+ * @brief
+ * Sensor rotation matrices of a batch of poses, one per (pose, sensor), in an aligned
+ * structure-of-arrays block: each of the 9 matrix elements is a contiguous float array with
+ * one entry per (pose, sensor), entry pose * numSensors + sensor. Arrays start on 64-byte
+ * boundaries and are padded to a multiple of 16 floats, so consumers can load them with any
+ * SIMD width.
+ *
+ * Rotations use the ZYX (yaw-pitch-roll) convention, R = Rz(yaw) * Ry(pitch) * Rx(roll), with
+ * the sensor angles of the pose in degrees; sensors missing from a pose get a zero angle. The
+ * sines and cosines of all angles are computed in one branch-free polynomial pass that the
+ * compiler vectorizes, instead of one scalar std::sin/std::cos call per angle.
+ */
+class SensorRotations
+{
+public:
+    /* Alignment of every element array, in bytes. */
+    static constexpr size_t kAlignment = 64;
+
+    /**
+     * @brief
+     * Creates an empty block.
+     */
+    SensorRotations();
+
+    /**
+     * @brief
+     * Computes the rotations of all sensors of all poses.
+     *
+     * @param[in] poses         : poses in delivery order.
+     * @param[in] sensorNames   : sensors to compute rotations for, in output order.
+     */
+    SensorRotations(const std::vector<Augmenter::Pose>& poses, const std::vector<std::string>& sensorNames);
+
+    /**
+     * @brief
+     * Returns the number of poses.
+     */
+    uint32_t getNumPoses() const;
+
+    /**
+     * @brief
+     * Returns the number of sensors per pose.
+     */
+    uint32_t getNumSensors() const;
+
+    /**
+     * @brief
+     * Returns the array of matrix element (row, col) of all rotations, aligned to kAlignment
+     * and holding at least getNumPoses() * getNumSensors() entries.
+     *
+     * @param[in] row           : the matrix row, 0 to 2.
+     * @param[in] col           : the matrix column, 0 to 2.
+     */
+    const float* getElement(uint32_t row, uint32_t col) const;
+
+    /**
+     * @brief
+     * Returns the row-major rotation matrix of one sensor of one pose.
+     *
+     * @param[in] pose          : the index of the pose.
+     * @param[in] sensor        : the index of the sensor in the sensor names.
+     */
+    std::array<float, 9> getMatrix(uint32_t pose, uint32_t sensor) const;
+
+    /**
+     * @brief
+     * Computes the sine and cosine of n angles given in degrees.
+     *
+     * @param[in] degrees       : the angles.
+     * @param[out] sines        : the sines of the angles.
+     * @param[out] cosines      : the cosines of the angles.
+     * @param[in] n             : the number of angles.
+     */
+    static void sinCosDegrees(const float* degrees, float* sines, float* cosines, size_t n);
+
+private:
+    /* Minimal allocator for storage aligned to kAlignment. */
+    template <typename T>
+    struct alignedAllocator
+    {
+        using value_type = T;
+
+        alignedAllocator() = default;
+        template <typename U>
+        alignedAllocator(const alignedAllocator<U>&)
+        {
+        }
+
+        T* allocate(size_t n)
+        {
+            const size_t bytes = (n * sizeof(T) + kAlignment - 1) / kAlignment * kAlignment;
+            void* memory       = std::aligned_alloc(kAlignment, bytes);
+            if (!memory)
+            {
+                throw std::bad_alloc();
+            }
+            return static_cast<T*>(memory);
+        }
+        void deallocate(T* memory, size_t)
+        {
+            std::free(memory);
+        }
+        template <typename U>
+        bool operator==(const alignedAllocator<U>&) const
+        {
+            return true;
+        }
+        template <typename U>
+        bool operator!=(const alignedAllocator<U>&) const
+        {
+            return false;
+        }
+    };
+
+    uint32_t m_numPoses;
+
+    uint32_t m_numSensors;
+
+    /* Floats between the starts of consecutive element arrays. */
+    size_t m_stride;
+
+    /* The 9 element arrays, row-major, m_stride floats apart. */
+    std::vector<float, alignedAllocator<float>> m_elements;
+};
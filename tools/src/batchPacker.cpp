@@ -0,0 +1,250 @@
+/*******************************************************************************
+ *
+ * @file batchPacker.cpp
+ *
+ ******************************************************************************/
+
+#include <algorithm>  // for min(), sort(), stable_sort()
+#include <cstdint>    // for UINT32_MAX
+#include <functional> // for greater
+#include <numeric>    // for accumulate()
+#include <queue>      // for priority_queue
+#include <stdexcept>
+#include <string>     // for to_string()
+
+#include "batchPacker.hpp"
+
+BatchPacker::BatchPacker(const costModel& model)
+    : m_model(model), m_corrections({1.0, 1.0}), m_measured({false, false})
+{
+}
+
+double BatchPacker::modelCost(const Augmenter::Pose& pose) const
+{
+    double cost = m_model.poseCost + (pose.flip ? m_model.flipCost : 0.0);
+    for (const auto& sensor : pose.sensor_yaw)
+    {
+        auto sensorCost = m_model.sensorCosts.find(sensor.first);
+        if (sensorCost != m_model.sensorCosts.end())
+        {
+            cost += sensorCost->second;
+        }
+    }
+    return cost;
+}
+
+double BatchPacker::estimateCost(const Augmenter::Pose& pose) const
+{
+    return modelCost(pose) * m_corrections[pose.flip];
+}
+
+std::vector<double> BatchPacker::estimateCosts(const std::vector<Augmenter::Pose>& poses) const
+{
+    std::vector<double> costs;
+    costs.reserve(poses.size());
+    for (const auto& pose : poses)
+    {
+        costs.push_back(estimateCost(pose));
+    }
+    return costs;
+}
+
+void BatchPacker::recordCost(const Augmenter::Pose& pose, double measuredCost)
+{
+    const double modeled = modelCost(pose);
+    if (!(modeled > 0) || !(measuredCost >= 0))
+    {
+        return;
+    }
+    // The first measurement replaces the default ratio of 1.
+    const double ratio = measuredCost / modeled;
+    double& correction = m_corrections[pose.flip];
+    if (m_measured[pose.flip])
+    {
+        correction += kCorrectionWeight * (ratio - correction);
+    }
+    else
+    {
+        correction            = ratio;
+        m_measured[pose.flip] = true;
+    }
+}
+
+BatchPacker::packing BatchPacker::assignWorkers(const std::vector<Augmenter::Pose>& poses,
+                                                const std::vector<double>& costs,
+                                                uint32_t numWorkers,
+                                                const std::vector<uint32_t>& keyframeOffsets)
+{
+    if (numWorkers == 0)
+    {
+        throw std::invalid_argument("cannot assign poses to zero workers");
+    }
+    packing result;
+    result.bins.resize(numWorkers);
+    result.binCosts.assign(numWorkers, 0.0);
+    pack(costs, findRuns(poses, costs, keyframeOffsets), 0, numWorkers, UINT32_MAX, result);
+    return result;
+}
+
+BatchPacker::packing BatchPacker::packBatches(const std::vector<Augmenter::Pose>& poses,
+                                              const std::vector<double>& costs,
+                                              uint32_t batchSize,
+                                              const std::vector<uint32_t>& keyframeOffsets)
+{
+    if (batchSize == 0)
+    {
+        throw std::invalid_argument("cannot pack poses into batches of size zero");
+    }
+    std::vector<decodeRun> runs = findRuns(poses, costs, keyframeOffsets);
+    const uint32_t numPoses     = static_cast<uint32_t>(poses.size());
+    const uint32_t numBatches   = static_cast<uint32_t>((uint64_t(numPoses) + batchSize - 1) / batchSize);
+    packing result;
+    result.bins.resize(numBatches);
+    result.binCosts.assign(numBatches, 0.0);
+
+    // Windows of kWindowBatches full batches; a run crossing a window boundary is cut there.
+    size_t next = 0;
+    for (uint32_t firstBin = 0; firstBin < numBatches; firstBin += kWindowBatches)
+    {
+        const uint32_t numBins   = std::min(kWindowBatches, numBatches - firstBin);
+        const uint32_t windowEnd = static_cast<uint32_t>(
+            std::min<uint64_t>(numPoses, (uint64_t(firstBin) + numBins) * batchSize));
+        std::vector<decodeRun> windowRuns;
+        for (; next < runs.size() && runs[next].begin < windowEnd; ++next)
+        {
+            decodeRun& run = runs[next];
+            if (run.end > windowEnd)
+            {
+                // The rest of the run is left to the next window.
+                const double cost = std::accumulate(costs.begin() + run.begin, costs.begin() + windowEnd, 0.0);
+                windowRuns.push_back({run.begin, windowEnd, cost});
+                run.begin = windowEnd;
+                run.cost -= cost;
+                break;
+            }
+            windowRuns.push_back(run);
+        }
+        pack(costs, std::move(windowRuns), firstBin, numBins, batchSize, result);
+    }
+    return result;
+}
+
+std::vector<BatchPacker::decodeRun> BatchPacker::findRuns(const std::vector<Augmenter::Pose>& poses,
+                                                          const std::vector<double>& costs,
+                                                          const std::vector<uint32_t>& keyframeOffsets)
+{
+    if (costs.size() != poses.size())
+    {
+        throw std::invalid_argument("got " + std::to_string(costs.size()) + " costs for " +
+                                    std::to_string(poses.size()) + " poses");
+    }
+    // Poses decode from their keyframe with a GOP index, from their own frame otherwise.
+    auto decodeUnit = [&](const Augmenter::Pose& pose) {
+        if (keyframeOffsets.empty())
+        {
+            return pose.srcFrame;
+        }
+        if (pose.srcFrame >= keyframeOffsets.size() || keyframeOffsets[pose.srcFrame] > pose.srcFrame)
+        {
+            throw std::invalid_argument("GOP index does not cover frame " + std::to_string(pose.srcFrame));
+        }
+        return pose.srcFrame - keyframeOffsets[pose.srcFrame];
+    };
+
+    std::vector<decodeRun> runs;
+    for (uint32_t i = 0; i < poses.size(); ++i)
+    {
+        if (i == 0 || decodeUnit(poses[i]) != decodeUnit(poses[i - 1]))
+        {
+            runs.push_back({i, i, 0.0});
+        }
+        runs.back().end = i + 1;
+        runs.back().cost += costs[i];
+    }
+    return runs;
+}
+
+void BatchPacker::pack(const std::vector<double>& costs,
+                       std::vector<decodeRun> runs,
+                       uint32_t firstBin,
+                       uint32_t numBins,
+                       uint32_t capacity,
+                       packing& result)
+{
+    if (numBins == 0)
+    {
+        return;
+    }
+
+    // Most expensive runs first; ties keep delivery order so packing is deterministic.
+    std::stable_sort(runs.begin(), runs.end(),
+                     [](const decodeRun& a, const decodeRun& b) { return a.cost > b.cost; });
+
+    auto place = [&](uint32_t bin, uint32_t begin, uint32_t end) {
+        std::vector<uint32_t>& poses = result.bins[bin];
+        for (uint32_t pose = begin; pose < end; ++pose)
+        {
+            poses.push_back(pose);
+            result.binCosts[bin] += costs[pose];
+        }
+    };
+
+    if (capacity == UINT32_MAX)
+    {
+        // Min-heap of (bin cost, bin): every run goes whole to the cheapest bin.
+        using binLoad = std::pair<double, uint32_t>;
+        std::priority_queue<binLoad, std::vector<binLoad>, std::greater<binLoad>> loads;
+        for (uint32_t bin = firstBin; bin < firstBin + numBins; ++bin)
+        {
+            loads.emplace(result.binCosts[bin], bin);
+        }
+        for (const auto& run : runs)
+        {
+            const uint32_t bin = loads.top().second;
+            loads.pop();
+            place(bin, run.begin, run.end);
+            loads.emplace(result.binCosts[bin], bin);
+        }
+    }
+    else
+    {
+        // Few bins per window: scan them for the cheapest one the run fits whole.
+        auto room = [&](uint32_t bin) { return capacity - static_cast<uint32_t>(result.bins[bin].size()); };
+        for (const auto& run : runs)
+        {
+            const uint32_t size = run.end - run.begin;
+            uint32_t best       = UINT32_MAX;
+            for (uint32_t bin = firstBin; bin < firstBin + numBins; ++bin)
+            {
+                if (room(bin) >= size && (best == UINT32_MAX || result.binCosts[bin] < result.binCosts[best]))
+                {
+                    best = bin;
+                }
+            }
+            if (best != UINT32_MAX)
+            {
+                place(best, run.begin, run.end);
+                continue;
+            }
+            // No bin has room for the whole run: fill the roomiest bins, splitting it as
+            // little as possible. The window has room for all of its poses.
+            for (uint32_t begin = run.begin; begin < run.end;)
+            {
+                uint32_t roomiest = firstBin;
+                for (uint32_t bin = firstBin + 1; bin < firstBin + numBins; ++bin)
+                {
+                    roomiest = room(bin) > room(roomiest) ? bin : roomiest;
+                }
+                const uint32_t end = std::min(run.end, begin + room(roomiest));
+                place(roomiest, begin, end);
+                begin = end;
+            }
+        }
+    }
+
+    // Deliver every bin in the order the poses were delivered.
+    for (uint32_t bin = firstBin; bin < firstBin + numBins; ++bin)
+    {
+        std::sort(result.bins[bin].begin(), result.bins[bin].end());
+    }
+}
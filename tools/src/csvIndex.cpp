@@ -0,0 +1,224 @@
+/*******************************************************************************
+ *
+ * @file csvIndex.cpp
+ *
+ ******************************************************************************/
+
+#include <cstring> // for memcpy()
+
+#include "csvIndex.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#define CSVINDEX_X86 1
+#endif
+
+namespace
+{
+
+// Comma, quote and newline bitmasks of one 64-byte block (bit i = byte i).
+struct blockMasks
+{
+    uint64_t comma;
+    uint64_t quote;
+    uint64_t newline;
+};
+
+#if defined(CSVINDEX_X86)
+blockMasks classifySse2(const char* block)
+{
+    const __m128i comma   = _mm_set1_epi8(',');
+    const __m128i quote   = _mm_set1_epi8('"');
+    const __m128i newline = _mm_set1_epi8('\n');
+    blockMasks masks      = {0, 0, 0};
+    for (int i = 0; i < 4; ++i)
+    {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16 * i));
+        masks.comma |= uint64_t(uint16_t(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, comma))))
+                       << (16 * i);
+        masks.quote |= uint64_t(uint16_t(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, quote))))
+                       << (16 * i);
+        masks.newline |= uint64_t(uint16_t(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, newline))))
+                         << (16 * i);
+    }
+    return masks;
+}
+
+__attribute__((target("avx2"))) blockMasks classifyAvx2(const char* block)
+{
+    const __m256i comma   = _mm256_set1_epi8(',');
+    const __m256i quote   = _mm256_set1_epi8('"');
+    const __m256i newline = _mm256_set1_epi8('\n');
+    blockMasks masks      = {0, 0, 0};
+    for (int i = 0; i < 2; ++i)
+    {
+        const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + 32 * i));
+        masks.comma |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, comma))))
+                       << (32 * i);
+        masks.quote |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, quote))))
+                       << (32 * i);
+        masks.newline |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, newline))))
+                         << (32 * i);
+    }
+    return masks;
+}
+#else
+blockMasks classifyScalar(const char* block)
+{
+    blockMasks masks = {0, 0, 0};
+    for (int i = 0; i < 64; ++i)
+    {
+        masks.comma |= uint64_t(block[i] == ',') << i;
+        masks.quote |= uint64_t(block[i] == '"') << i;
+        masks.newline |= uint64_t(block[i] == '\n') << i;
+    }
+    return masks;
+}
+#endif
+
+// Bit i of the result is the XOR of bits 0..i, i.e. "inside quotes" after byte i.
+uint64_t prefixXor(uint64_t bits)
+{
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+}
+
+using classifyFunction = blockMasks (*)(const char*);
+
+classifyFunction selectClassifier()
+{
+#if defined(CSVINDEX_X86)
+#if defined(__GNUC__)
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return classifyAvx2;
+    }
+#endif
+    return classifySse2;
+#else
+    return classifyScalar;
+#endif
+}
+
+// Classifies the buffer block by block and calls onBlock(offset, masks, inQuote) for every
+// 64-byte block. Returns true if the buffer ends inside quotes.
+template <typename BlockFunction>
+bool scanBlocks(const char* data, size_t size, BlockFunction&& onBlock)
+{
+    static const classifyFunction classify = selectClassifier();
+
+    uint64_t inQuoteCarry = 0; // all ones if the previous block ended inside quotes
+    char tail[64];
+    for (size_t offset = 0; offset < size; offset += 64)
+    {
+        const char* block = data + offset;
+        if (size - offset < 64)
+        {
+            // Pad the last partial block with a byte that is not structural.
+            std::memset(tail, ' ', sizeof(tail));
+            std::memcpy(tail, block, size - offset);
+            block = tail;
+        }
+        const blockMasks masks = classify(block);
+
+        const uint64_t inQuote = prefixXor(masks.quote) ^ inQuoteCarry;
+        inQuoteCarry           = uint64_t(0) - (inQuote >> 63);
+
+        onBlock(offset, masks, inQuote);
+    }
+    return inQuoteCarry != 0;
+}
+
+} // namespace
+
+CsvIndex::CsvIndex(const char* data, size_t size, bool newlinesOnly) : m_endsInQuote(false)
+{
+    // Roughly one cell per 8 bytes and one line per 32 bytes for typical label files.
+    m_structurals.reserve(newlinesOnly ? size / 32 : size / 8);
+    scan(data, size, newlinesOnly);
+}
+
+void CsvIndex::scan(const char* data, size_t size, bool newlinesOnly)
+{
+    const uint64_t commaBits = newlinesOnly ? 0 : ~uint64_t(0);
+    auto onBlock = [this, commaBits](size_t offset, const blockMasks& masks, uint64_t inQuote) {
+        uint64_t structural = ((masks.comma & commaBits) | masks.newline) & ~inQuote;
+        while (structural)
+        {
+            m_structurals.push_back(offset + __builtin_ctzll(structural));
+            structural &= structural - 1;
+        }
+    };
+    m_endsInQuote = scanBlocks(data, size, onBlock);
+}
+
+uint64_t CsvIndex::countLines(const char* data, size_t size)
+{
+    // Count unquoted newlines, minus those ending a blank line ("\n\n" or "\n\r\n"). The start
+    // of the buffer counts as a newline at offset -1.
+    uint64_t lines       = 0;
+    uint64_t lineStart   = 0;
+    uint64_t newlineBits = uint64_t(1) << 63; // newlines of the previous block
+    scanBlocks(data, size, [&](size_t offset, const blockMasks& masks, uint64_t inQuote) {
+        const uint64_t newline = masks.newline & ~inQuote;
+        const uint64_t after1  = (newline << 1) | (newlineBits >> 63);
+        const uint64_t after2  = (newline << 2) | (newlineBits >> 62);
+        lines += __builtin_popcountll(newline) - __builtin_popcountll(newline & after1);
+
+        // Newlines two bytes after another newline end a blank line if the byte between is '\r'.
+        uint64_t candidates = newline & after2 & ~after1;
+        while (candidates)
+        {
+            lines -= data[offset + __builtin_ctzll(candidates) - 1] == '\r';
+            candidates &= candidates - 1;
+        }
+        if (newline)
+        {
+            lineStart = offset + 64 - __builtin_clzll(newline);
+        }
+        newlineBits = newline;
+    });
+
+    // A last line without a newline.
+    const uint64_t rest = size - lineStart;
+    lines += rest > 1 || (rest == 1 && data[lineStart] != '\r');
+    return lines;
+}
+
+const std::vector<uint64_t>& CsvIndex::getStructurals() const
+{
+    return m_structurals;
+}
+
+bool CsvIndex::endsInQuote() const
+{
+    return m_endsInQuote;
+}
+
+std::string CsvIndex::cellText(const char* data, uint64_t begin, uint64_t end)
+{
+    if (end > begin && data[end - 1] == '\r')
+    {
+        --end;
+    }
+    if (end - begin < 2 || data[begin] != '"' || data[end - 1] != '"')
+    {
+        return std::string(data + begin, end - begin);
+    }
+    // Quoted cell: drop the surrounding quotes and unescape "".
+    std::string text;
+    for (uint64_t i = begin + 1; i + 1 < end; ++i)
+    {
+        text += data[i];
+        if (data[i] == '"' && data[i + 1] == '"')
+        {
+            ++i;
+        }
+    }
+    return text;
+}
@@ -0,0 +1,168 @@
+/*******************************************************************************
+ *
+ * @file ensembleRandom.cpp
+ *
+ ******************************************************************************/
+
+#include <cmath>   // for log(), sqrt()
+#include <cstring> // for memcpy()
+
+#include "ensembleRandom.hpp"
+#include "sensorRotations.hpp"
+
+namespace
+{
+
+// One splitmix64 step, used to expand a seed into a xoshiro256 state.
+uint64_t splitMix64(uint64_t& state)
+{
+    uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+    z          = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z          = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+// Advances the masked lanes of one tile (xoshiro256+) and writes a uniform double in [0, 1)
+// of every lane. A loop of constant length needs no scalar epilogue, so it vectorizes under
+// the cheap cost model of -O2 too.
+void stepTile(uint64_t* __restrict s0,
+              uint64_t* __restrict s1,
+              uint64_t* __restrict s2,
+              uint64_t* __restrict s3,
+              const uint64_t* __restrict mask,
+              double* __restrict values)
+{
+    for (size_t i = 0; i < EnsembleRandom::kTile; ++i)
+    {
+        const uint64_t result = s0[i] + s3[i];
+        const uint64_t t      = s1[i] << 17;
+        uint64_t n2           = s2[i] ^ s0[i];
+        uint64_t n3           = s3[i] ^ s1[i];
+        const uint64_t n1     = s1[i] ^ n2;
+        const uint64_t n0     = s0[i] ^ n3;
+        n2 ^= t;
+        n3 = (n3 << 45) | (n3 >> 19);
+
+        // Bit masks instead of branches: masked out lanes keep their state.
+        const uint64_t on = mask[i];
+        s0[i]             = (n0 & on) | (s0[i] & ~on);
+        s1[i]             = (n1 & on) | (s1[i] & ~on);
+        s2[i]             = (n2 & on) | (s2[i] & ~on);
+        s3[i]             = (n3 & on) | (s3[i] & ~on);
+        // The top 52 bits as the mantissa of a double in [1, 2), minus 1.
+        const uint64_t bits = (result >> 12) | 0x3ff0000000000000ull;
+        double value;
+        std::memcpy(&value, &bits, sizeof(double));
+        values[i] = value - 1.0;
+    }
+}
+
+} // namespace
+
+EnsembleRandom::EnsembleRandom(const std::vector<uint64_t>& seeds)
+    : m_numLanes(seeds.size())
+{
+    // Padding lanes get a state too, so that stepping them is well defined; they are never
+    // masked in.
+    const size_t paddedLanes = (m_numLanes + kTile - 1) / kTile * kTile;
+    m_s0.resize(paddedLanes);
+    m_s1.resize(paddedLanes);
+    m_s2.resize(paddedLanes);
+    m_s3.resize(paddedLanes);
+    for (size_t lane = 0; lane < paddedLanes; ++lane)
+    {
+        uint64_t state = lane < m_numLanes ? seeds[lane] : 0;
+        m_s0[lane]     = splitMix64(state);
+        m_s1[lane]     = splitMix64(state);
+        m_s2[lane]     = splitMix64(state);
+        m_s3[lane]     = splitMix64(state);
+    }
+    m_mask.resize(paddedLanes);
+    m_u1.resize(paddedLanes);
+    m_u2.resize(paddedLanes);
+    m_degrees.resize(paddedLanes);
+    m_sines.resize(paddedLanes);
+    m_cosines.resize(paddedLanes);
+}
+
+size_t EnsembleRandom::size() const
+{
+    return m_numLanes;
+}
+
+size_t EnsembleRandom::setMask(const uint8_t* active)
+{
+    size_t numActive = 0;
+    for (size_t lane = 0; lane < m_numLanes; ++lane)
+    {
+        m_mask[lane] = -static_cast<uint64_t>(active[lane] != 0);
+        numActive += active[lane] != 0;
+    }
+    return numActive;
+}
+
+void EnsembleRandom::step(double* values)
+{
+    for (size_t base = 0; base < m_s0.size(); base += kTile)
+    {
+        stepTile(m_s0.data() + base, m_s1.data() + base, m_s2.data() + base, m_s3.data() + base,
+                 m_mask.data() + base, values + base);
+    }
+}
+
+void EnsembleRandom::uniform01(const uint8_t* active, double* values)
+{
+    setMask(active);
+    step(m_u1.data());
+    for (size_t lane = 0; lane < m_numLanes; ++lane)
+    {
+        values[lane] = active[lane] ? m_u1[lane] : values[lane];
+    }
+}
+
+void EnsembleRandom::uniform(double max, const uint8_t* active, float* values)
+{
+    setMask(active);
+    step(m_u1.data());
+    for (size_t lane = 0; lane < m_numLanes; ++lane)
+    {
+        values[lane] = active[lane] ? static_cast<float>((2 * m_u1[lane] - 1) * max) : values[lane];
+    }
+}
+
+void EnsembleRandom::gaussian(double stdDev, double max, const uint8_t* active, float* values)
+{
+    if (!(stdDev > 0))
+    {
+        for (size_t lane = 0; lane < m_numLanes; ++lane)
+        {
+            values[lane] = active[lane] ? 0.0f : values[lane];
+        }
+        return;
+    }
+    const size_t paddedLanes = m_s0.size();
+    for (size_t numPending = setMask(active); numPending > 0;)
+    {
+        step(m_u1.data());
+        step(m_u2.data());
+        // cos(2 pi u2) through the batched polynomial of SensorRotations.
+        for (size_t lane = 0; lane < paddedLanes; ++lane)
+        {
+            m_degrees[lane] = static_cast<float>(360.0 * m_u2[lane]);
+        }
+        SensorRotations::sinCosDegrees(m_degrees.data(), m_sines.data(), m_cosines.data(), paddedLanes);
+        numPending = 0;
+        for (size_t lane = 0; lane < m_numLanes; ++lane)
+        {
+            if (m_mask[lane])
+            {
+                // 1 - u1 is in (0, 1], so the logarithm is finite.
+                const double value = stdDev * std::sqrt(-2.0 * std::log(1.0 - m_u1[lane])) * m_cosines[lane];
+                const bool accept  = value >= -max && value <= max;
+                values[lane]       = accept ? static_cast<float>(value) : values[lane];
+                m_mask[lane]       = accept ? 0 : m_mask[lane];
+                numPending += !accept;
+            }
+        }
+    }
+}
@@ -0,0 +1,111 @@
+/*******************************************************************************
+ *
+ * @file gzipReader.cpp
+ *
+ ******************************************************************************/
+
+#include <fstream>
+#include <stdexcept>
+
+#include <zlib.h>
+
+#include "gzipReader.hpp"
+
+GzipReader::GzipReader(const std::string& fileName, size_t chunkSize, size_t maxQueuedChunks)
+    : m_file(gzopen(fileName.c_str(), "rb"))
+    , m_fileName(fileName)
+    , m_chunkSize(chunkSize)
+    , m_maxQueuedChunks(maxQueuedChunks)
+    , m_done(false)
+    , m_stop(false)
+{
+    if (!m_file)
+    {
+        throw std::runtime_error("cannot open label file \"" + fileName + "\"");
+    }
+    // A larger input buffer than zlib's default 8 KiB keeps reads sequential and few.
+    gzbuffer(m_file, 256 * 1024);
+    m_thread = std::thread(&GzipReader::decompress, this);
+}
+
+GzipReader::~GzipReader()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_slotFree.notify_all();
+    m_thread.join();
+    gzclose(m_file);
+}
+
+bool GzipReader::next(std::string& chunk)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_chunkReady.wait(lock, [this] { return !m_chunks.empty() || m_done; });
+    if (m_chunks.empty())
+    {
+        if (!m_error.empty())
+        {
+            throw std::runtime_error(m_error);
+        }
+        return false;
+    }
+    chunk = std::move(m_chunks.front());
+    m_chunks.pop_front();
+    lock.unlock();
+    m_slotFree.notify_one();
+    return true;
+}
+
+void GzipReader::decompress()
+{
+    std::string error;
+    while (true)
+    {
+        std::string chunk(m_chunkSize, '\0');
+        const int bytesRead = gzread(m_file, &chunk[0], static_cast<unsigned>(m_chunkSize));
+        if (bytesRead < 0)
+        {
+            int errorCode = Z_OK;
+            error         = "cannot decompress label file \"" + m_fileName + "\": " + gzerror(m_file, &errorCode);
+            break;
+        }
+        if (bytesRead == 0)
+        {
+            // Z_BUF_ERROR at the end means the input ended in the middle of a gzip stream.
+            int errorCode = Z_OK;
+            const char* message = gzerror(m_file, &errorCode);
+            if (errorCode != Z_OK)
+            {
+                error = "cannot decompress label file \"" + m_fileName + "\": " + message;
+            }
+            break;
+        }
+        chunk.resize(bytesRead);
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_slotFree.wait(lock, [this] { return m_chunks.size() < m_maxQueuedChunks || m_stop; });
+        if (m_stop)
+        {
+            return;
+        }
+        m_chunks.push_back(std::move(chunk));
+        lock.unlock();
+        m_chunkReady.notify_one();
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_error = error;
+        m_done  = true;
+    }
+    m_chunkReady.notify_one();
+}
+
+bool GzipReader::isGzip(const std::string& fileName)
+{
+    std::ifstream in(fileName, std::ios::binary);
+    unsigned char magic[2] = {0, 0};
+    in.read(reinterpret_cast<char*>(magic), sizeof(magic));
+    return in && magic[0] == 0x1f && magic[1] == 0x8b;
+}
@@ -0,0 +1,333 @@
+/*******************************************************************************
+ *
+ * @file labelTable.cpp
+ *
+ ******************************************************************************/
+
+#include <algorithm> // for count(), find()
+#include <cmath>     // for NAN
+#include <cstdlib>   // for strtod()
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include <fcntl.h>    // for open()
+#include <sys/mman.h> // for mmap()
+#include <sys/stat.h> // for fstat()
+#include <unistd.h>   // for close()
+
+#include <projmeta/projmetadata.hpp>
+
+#include "csvIndex.hpp"
+#include "gzipReader.hpp"
+#include "labelTable.hpp"
+
+namespace
+{
+
+// Streams a gzip file as chunks of complete lines: calls onLines(data, size) for every chunk
+// that ends right after an unquoted newline, and once more for the rest of the file. The next
+// chunk is decompressed while onLines runs.
+template <typename LinesFunction>
+void streamLines(const std::string& fileName, LinesFunction&& onLines)
+{
+    GzipReader reader(fileName);
+    std::string pending;
+    std::string chunk;
+    while (reader.next(chunk))
+    {
+        pending += chunk;
+        // pending starts at a line start, i.e. outside quotes, so its line index is exact.
+        const CsvIndex lineEnds(pending.data(), pending.size(), true);
+        if (lineEnds.getStructurals().empty())
+        {
+            continue;
+        }
+        const uint64_t cut = lineEnds.getStructurals().back() + 1;
+        onLines(pending.data(), cut);
+        pending.erase(0, cut);
+    }
+    onLines(pending.data(), pending.size());
+}
+
+} // namespace
+
+LabelTable::LabelTable(const std::string& fileName, const std::vector<std::string>& fieldNames)
+    : m_numRows(0), m_fileName(fileName)
+{
+    load(fieldNames, nullptr, false);
+}
+
+LabelTable::LabelTable(const std::string& fileName,
+                       const std::vector<std::string>& fieldNames,
+                       const std::vector<uint32_t>& rowUseCounts)
+    : m_numRows(0), m_fileName(fileName)
+{
+    // Indexing lines one by one only pays off if a good part of the rows is skipped.
+    const size_t numSkipped = std::count(rowUseCounts.begin(), rowUseCounts.end(), 0u);
+    load(fieldNames, &rowUseCounts, numSkipped * 4 >= rowUseCounts.size());
+    if (m_numRows != rowUseCounts.size())
+    {
+        throw std::invalid_argument("Trace has " + std::to_string(m_numRows) + " frames, but use count has " +
+                                    std::to_string(rowUseCounts.size()) + " entries.");
+    }
+}
+
+void LabelTable::load(const std::vector<std::string>& fieldNames,
+                      const std::vector<uint32_t>* rowUseCounts,
+                      bool skipLines)
+{
+    parseState state = {fieldNames, rowUseCounts, skipLines, false, {}, {}};
+    if (GzipReader::isGzip(m_fileName))
+    {
+        streamLines(m_fileName, [&](const char* data, uint64_t size) { parseLines(data, size, state); });
+    }
+    else
+    {
+        const std::string content = readFile(m_fileName);
+        parseLines(content.data(), content.size(), state);
+    }
+    if (!state.haveHeader)
+    {
+        // Only blank lines: parse an empty header, so that requested fields are reported.
+        parseLines("", 0, state);
+    }
+}
+
+std::string LabelTable::readFile(const std::string& fileName)
+{
+    std::ifstream in(fileName, std::ios::binary);
+    if (!in)
+    {
+        throw std::runtime_error("cannot open label file \"" + fileName + "\"");
+    }
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    return buffer.str();
+}
+
+uint32_t LabelTable::countRows(const std::string& fileName)
+{
+    if (GzipReader::isGzip(fileName))
+    {
+        uint64_t lines = 0;
+        streamLines(fileName,
+                    [&](const char* data, uint64_t size) { lines += CsvIndex::countLines(data, size); });
+        return lines > 0 ? static_cast<uint32_t>(lines - 1) : 0;
+    }
+
+    const int fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        throw std::runtime_error("cannot open label file \"" + fileName + "\"");
+    }
+    struct stat info;
+    if (::fstat(fd, &info) != 0 || info.st_size == 0)
+    {
+        ::close(fd);
+        return 0;
+    }
+    const size_t size = info.st_size;
+    void* mapped      = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+
+    uint64_t lines = 0;
+    if (mapped == MAP_FAILED)
+    {
+        // Not mappable (e.g. a pipe): count from a regular read.
+        std::ifstream in(fileName, std::ios::binary);
+        std::stringstream buffer;
+        buffer << in.rdbuf();
+        const std::string content = buffer.str();
+        lines                     = CsvIndex::countLines(content.data(), content.size());
+    }
+    else
+    {
+        ::madvise(mapped, size, MADV_SEQUENTIAL);
+        lines = CsvIndex::countLines(static_cast<const char*>(mapped), size);
+        ::munmap(mapped, size);
+    }
+    // The first line is the header.
+    return lines > 0 ? static_cast<uint32_t>(lines - 1) : 0;
+}
+
+void LabelTable::parseLines(const char* data, uint64_t end, parseState& state)
+{
+    // Skipping lines only needs line boundaries of the whole chunk; the cells of the lines
+    // that are kept are indexed one line at a time.
+    const CsvIndex index(data, end, state.skipLines);
+    const std::vector<uint64_t>& structurals = index.getStructurals();
+    std::vector<cellSpan>& spans             = state.spans;
+    size_t next                              = 0;
+    uint64_t lineBegin                       = 0;
+
+    if (!state.haveHeader)
+    {
+        // The header is the first non-blank line, as counted by CsvIndex::countLines. A chunk
+        // of blank lines only leaves the header to the next chunk.
+        while (next < structurals.size() && data[structurals[next]] == '\n' &&
+               isBlankCell(data, cellSpan(lineBegin, structurals[next])))
+        {
+            lineBegin = structurals[next++] + 1;
+        }
+        if (lineBegin > 0 && lineBegin == end)
+        {
+            return;
+        }
+
+        // Map requested fields to their position in the header.
+        lineBegin = splitLine(data, end, structurals, next, lineBegin, state.skipLines, spans) + 1;
+        std::vector<std::string> header;
+        for (const auto& span : spans)
+        {
+            header.push_back(CsvIndex::cellText(data, span.first, span.second));
+        }
+        for (const auto& fieldName : state.fieldNames)
+        {
+            auto position = std::find(header.begin(), header.end(), fieldName);
+            if (position == header.end())
+            {
+                throw std::invalid_argument("label file \"" + m_fileName + "\" has no field \"" +
+                                            fieldName + "\"");
+            }
+            column& col = m_columns[fieldName];
+            col.numeric = projMetaData::isFieldNumeric(fieldName);
+            state.targets.push_back({static_cast<size_t>(position - header.begin()), &col});
+        }
+        state.haveHeader = true;
+    }
+
+    // One data line per frame; blank lines are ignored. Only the requested cells are
+    // converted, and in a selective load only those of rows with a nonzero use count.
+    const std::vector<uint32_t>* rowUseCounts = state.rowUseCounts;
+    auto isUsed                               = [&]() {
+        return !rowUseCounts || (m_numRows < rowUseCounts->size() && (*rowUseCounts)[m_numRows] != 0);
+    };
+    while (lineBegin < end)
+    {
+        uint64_t lineEnd = 0;
+        bool blank       = false;
+        if (state.skipLines && !isUsed())
+        {
+            // Unused rows are skipped from the line index alone.
+            lineEnd = next < structurals.size() ? structurals[next++] : end;
+            blank   = isBlankCell(data, cellSpan(lineBegin, lineEnd));
+            spans.clear();
+        }
+        else
+        {
+            lineEnd = splitLine(data, end, structurals, next, lineBegin, state.skipLines, spans);
+            blank   = spans.size() == 1 && isBlankCell(data, spans[0]);
+            if (!isUsed())
+            {
+                spans.clear();
+            }
+        }
+        if (!blank)
+        {
+            for (auto& target : state.targets)
+            {
+                const cellSpan span = target.first < spans.size() ? spans[target.first] : cellSpan(0, 0);
+                appendCell(*target.second, CsvIndex::cellText(data, span.first, span.second));
+            }
+            ++m_numRows;
+        }
+        lineBegin = lineEnd + 1;
+    }
+}
+
+bool LabelTable::isBlankCell(const char* data, const cellSpan& span)
+{
+    return span.second == span.first || (span.second == span.first + 1 && data[span.first] == '\r');
+}
+
+uint64_t LabelTable::splitLine(const char* data,
+                               uint64_t end,
+                               const std::vector<uint64_t>& structurals,
+                               size_t& next,
+                               uint64_t lineBegin,
+                               bool linesOnly,
+                               std::vector<cellSpan>& spans)
+{
+    spans.clear();
+    if (linesOnly)
+    {
+        // Index the cells of this line only.
+        const uint64_t lineEnd = next < structurals.size() ? structurals[next++] : end;
+        const CsvIndex cells(data + lineBegin, lineEnd - lineBegin);
+        uint64_t cellBegin = lineBegin;
+        for (uint64_t separator : cells.getStructurals())
+        {
+            spans.emplace_back(cellBegin, lineBegin + separator);
+            cellBegin = lineBegin + separator + 1;
+        }
+        spans.emplace_back(cellBegin, lineEnd);
+        return lineEnd;
+    }
+    uint64_t cellBegin = lineBegin;
+    while (next < structurals.size())
+    {
+        const uint64_t separator = structurals[next++];
+        spans.emplace_back(cellBegin, separator);
+        cellBegin = separator + 1;
+        if (data[separator] == '\n')
+        {
+            return separator;
+        }
+    }
+    spans.emplace_back(cellBegin, end);
+    return end;
+}
+
+void LabelTable::appendCell(column& col, const std::string& value)
+{
+    if (col.numeric)
+    {
+        char* end = nullptr;
+        double number = std::strtod(value.c_str(), &end);
+        col.numbers.push_back((value.empty() || end == value.c_str()) ? NAN : number);
+        return;
+    }
+    auto inserted = col.lookup.emplace(value, col.dictionary.size());
+    if (inserted.second)
+    {
+        col.dictionary.push_back(value);
+    }
+    col.ids.push_back(inserted.first->second);
+}
+
+uint32_t LabelTable::getNumRows() const
+{
+    return m_numRows;
+}
+
+const LabelTable::column& LabelTable::getColumn(const std::string& fieldName) const
+{
+    auto col = m_columns.find(fieldName);
+    if (col == m_columns.end())
+    {
+        throw std::invalid_argument("field \"" + fieldName + "\" was not loaded from \"" +
+                                    m_fileName + "\"");
+    }
+    return col->second;
+}
+
+bool LabelTable::isNumeric(const std::string& fieldName) const
+{
+    return getColumn(fieldName).numeric;
+}
+
+const std::vector<double>& LabelTable::getNumericColumn(const std::string& fieldName) const
+{
+    return getColumn(fieldName).numbers;
+}
+
+const std::vector<uint32_t>& LabelTable::getStringColumn(const std::string& fieldName) const
+{
+    return getColumn(fieldName).ids;
+}
+
+const std::vector<std::string>& LabelTable::getDictionary(const std::string& fieldName) const
+{
+    return getColumn(fieldName).dictionary;
+}
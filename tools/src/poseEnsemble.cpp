@@ -0,0 +1,102 @@
+/*******************************************************************************
+ *
+ * @file poseEnsemble.cpp
+ *
+ ******************************************************************************/
+
+#include <stdexcept>
+#include <utility> // for move()
+
+#include "poseEnsemble.hpp"
+
+PoseEnsemble::PoseEnsemble()
+    : m_numSets(0), m_numFields(3)
+{
+}
+
+PoseEnsemble::PoseEnsemble(std::vector<std::string> sensorNames,
+                           size_t numSets,
+                           std::vector<uint32_t> srcFrames,
+                           std::vector<uint8_t> flips,
+                           std::vector<float> values,
+                           std::vector<uint32_t> orders)
+    : m_sensorNames(std::move(sensorNames))
+    , m_numSets(numSets)
+    , m_numFields(3 + 3 * m_sensorNames.size())
+    , m_srcFrames(std::move(srcFrames))
+    , m_flips(std::move(flips))
+    , m_values(std::move(values))
+    , m_orders(std::move(orders))
+{
+    const size_t numSlots = m_srcFrames.size();
+    if (m_flips.size() != numSlots || m_values.size() != numSlots * m_numFields * m_numSets ||
+        m_orders.size() != numSlots * m_numSets)
+    {
+        throw std::invalid_argument("pose ensemble of " + std::to_string(m_numSets) + " sets and " +
+                                    std::to_string(numSlots) + " slots has mismatched value or order sizes");
+    }
+    for (uint32_t slot : m_orders)
+    {
+        if (slot >= numSlots)
+        {
+            throw std::invalid_argument("pose ensemble order refers to slot " + std::to_string(slot) +
+                                        " of " + std::to_string(numSlots));
+        }
+    }
+}
+
+size_t PoseEnsemble::size() const
+{
+    return m_numSets;
+}
+
+size_t PoseEnsemble::getNumPoses() const
+{
+    return m_srcFrames.size();
+}
+
+const std::vector<std::string>& PoseEnsemble::getSensorNames() const
+{
+    return m_sensorNames;
+}
+
+Augmenter::Pose PoseEnsemble::getPose(size_t set, size_t index) const
+{
+    Augmenter::Pose pose = {};
+    getPose(set, index, pose);
+    return pose;
+}
+
+void PoseEnsemble::getPose(size_t set, size_t index, Augmenter::Pose& pose) const
+{
+    if (set >= m_numSets || index >= m_srcFrames.size())
+    {
+        throw std::out_of_range("pose " + std::to_string(index) + " of set " + std::to_string(set) +
+                                " is out of range");
+    }
+    // Fields of a slot lie m_numSets values apart.
+    const uint32_t slot = m_orders[set * m_srcFrames.size() + index];
+    const float* values = &m_values[slot * m_numFields * m_numSets + set];
+    pose.shift          = values[0];
+    pose.rotation       = values[m_numSets];
+    pose.forward        = values[2 * m_numSets];
+    for (size_t s = 0; s < m_sensorNames.size(); ++s)
+    {
+        const float* angles                 = values + (3 + 3 * s) * m_numSets;
+        pose.sensor_yaw[m_sensorNames[s]]   = angles[0];
+        pose.sensor_pitch[m_sensorNames[s]] = angles[m_numSets];
+        pose.sensor_roll[m_sensorNames[s]]  = angles[2 * m_numSets];
+    }
+    pose.flip     = m_flips[slot] != 0;
+    pose.srcFrame = m_srcFrames[slot];
+}
+
+std::vector<Augmenter::Pose> PoseEnsemble::getPoses(size_t set) const
+{
+    std::vector<Augmenter::Pose> poses(m_srcFrames.size());
+    for (size_t i = 0; i < poses.size(); ++i)
+    {
+        getPose(set, i, poses[i]);
+    }
+    return poses;
+}
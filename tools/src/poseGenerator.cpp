@@ -4,40 +4,103 @@
  *
  ******************************************************************************/
 
-#include <random> // for uniform_real_distribution() & normal_distribution()
+#include <algorithm>  // for max(), rotate(), shuffle(), sort(), upper_bound()
+#include <cmath>      // for erfc(), sqrt()
+#include <cstdlib>    // for strtoul()
+#include <cstring>    // for memcpy()
+#include <fstream>
+#include <functional> // for function
+#include <iostream>   // for cerr
+#include <numeric>    // for iota(), partial_sum()
+#include <random>     // for uniform_real_distribution() & normal_distribution()
 
+#include "gzipReader.hpp"
 #include "poseGenerator.hpp"
+#include "poseProbes.hpp"
 
 using std::string;
 using std::map;
 using std::vector;
 
-PoseGenerator::PoseGenerator(const std::vector<std::pair<std::string, perturbParams>>& configRules,
-                             std::vector<std::string> sensorNames, unsigned int seed)
-    : m_sensorNames(sensorNames), m_generator(seed)
+namespace
+{
+
+// Formats frame ranges for error messages, e.g. "2-5, 9, 12-40".
+string describeRanges(const vector<RuleSet::frameRange>& ranges)
 {
-    for (auto rule : configRules)
+    const size_t kMaxListed = 20;
+    string text;
+    for (size_t r = 0; r < ranges.size() && r < kMaxListed; ++r)
+    {
+        text += (r ? ", " : "") + std::to_string(ranges[r].first);
+        if (ranges[r].last != ranges[r].first)
+        {
+            text += "-" + std::to_string(ranges[r].last);
+        }
+    }
+    if (ranges.size() > kMaxListed)
     {
-        // Splits a string ("key1=val1 key2=val2 ..") into a map of stringKey-val pairs.
-        map<string, string> labelConditions = projMetaData::stringMapFromSplitString(rule.first);
+        text += " and " + std::to_string(ranges.size() - kMaxListed) + " more ranges";
+    }
+    return text;
+}
+
+// Resampling rounds after which a frame with invalid poses is given up on.
+const uint32_t kMaxResampleRounds = 1000;
 
-        // Throw an error if the given labelCondition is not a stringLabel or invalid.
-        for (auto condition : labelConditions)
+// Frames a sequential decoder decodes to deliver poses (or pose slots) in the given order,
+// see PoseGenerator::computeDecodeCost().
+template <typename PoseT>
+uint64_t decodeCost(const vector<PoseT>& poses, const vector<uint32_t>& keyframeOffsets)
+{
+    uint64_t cost = 0;
+    for (size_t i = 0; i < poses.size(); ++i)
+    {
+        const uint32_t frame = poses[i].srcFrame;
+        if (i > 0 && poses[i - 1].srcFrame == frame)
         {
-            if (projMetaData::isFieldNumeric(condition.first))
-            {
-                throw std::invalid_argument("poses cannot be generated based on numeric label:\"" +
-                                            condition.first + "\"");
-            }
-            if (!projMetaData::isLabelValid(condition.first, condition.second))
-            {
-                throw std::invalid_argument("invalid label conditon: \"" + condition.first +
-                                            "\":\"" + condition.second + "\"");
-            }
+            continue;
         }
-        // Make a pair<map=labelConditions, perturbParams=rule.second> and add to m_perturbRules.
-        m_perturbRules.push_back(std::pair<map<string, string>, perturbParams>(labelConditions,
-                                                                               rule.second));
+        const uint32_t last = i > 0 ? poses[i - 1].srcFrame : 0;
+        const bool forward  = i > 0 && last < frame &&
+                             last - keyframeOffsets[last] == frame - keyframeOffsets[frame];
+        cost += forward ? frame - last : keyframeOffsets[frame] + 1;
+    }
+    return cost;
+}
+
+vector<string> ruleLabels(const vector<std::pair<string, PoseGenerator::perturbParams>>& configRules)
+{
+    vector<string> labels;
+    for (const auto& rule : configRules)
+    {
+        labels.push_back(rule.first);
+    }
+    return labels;
+}
+
+} // namespace
+
+PoseGenerator::PoseGenerator(const std::vector<std::pair<std::string, perturbParams>>& configRules,
+                             std::vector<std::string> sensorNames, uint64_t seed)
+    : m_ruleSet(ruleLabels(configRules))
+    , m_sensorNames(sensorNames)
+    , m_deliveryMode(ShufflePoses)
+    , m_deliveryStatistics({0, 0, 0, 0})
+    , m_maxBlockPoses(16)
+    , m_numRejectedPoses(0)
+    , m_latticeSteps(0)
+    , m_generator(seed)
+{
+    // Label conditions are parsed and validated by RuleSet; keep the parameters in rule order.
+    for (const auto& rule : configRules)
+    {
+        m_ruleParams.push_back(rule.second);
+    }
+    // Rules that can never fire are left out of matching; the config likely has a mistake.
+    for (const auto& warning : m_ruleSet.getWarnings())
+    {
+        std::cerr << "PoseGenerator: " << warning << std::endl;
     }
 }
 
@@ -45,23 +108,48 @@ std::vector<std::vector<Augmenter::Pose>> PoseGenerator::generatePoses4vecFrames
     std::vector<uint32_t> vecUseCounts,
     const std::string& labelsFileName)
 {
-    uint32_t numFrames = vecUseCounts.size();
-
-    // Use projMetaTrace class to use its member functions: getNumDatapoints() & doLabelsMatch()
-    projMetaData::projMetaTrace trace = projMetaData::projMetaTrace(labelsFileName);
-
-    if (trace.getNumDatapoints() != numFrames)
+    std::vector<int32_t> frameRules;
+    std::vector<std::vector<Augmenter::Pose>> vecVecPoses =
+        generateFramePoses(vecUseCounts, labelsFileName, frameRules);
+    if (m_sensorRotations || m_latticeSteps)
     {
-        throw std::invalid_argument("Trace has " + std::to_string(trace.getNumDatapoints()) +
-                                    " frames, but use count has " + std::to_string(numFrames) + " entries.");
+        std::vector<Augmenter::Pose> poses;
+        for (const auto& framePoses : vecVecPoses)
+        {
+            poses.insert(poses.end(), framePoses.begin(), framePoses.end());
+        }
+        computePoseOutputs(poses);
     }
+    return vecVecPoses;
+}
+
+std::vector<std::vector<Augmenter::Pose>> PoseGenerator::generateFramePoses(
+    const std::vector<uint32_t>& vecUseCounts,
+    const std::string& labelsFileName,
+    std::vector<int32_t>& frameRules)
+{
+    // Resolve and check coverage of all frames before generating anything.
+    frameRules = resolveFrameRules(vecUseCounts, labelsFileName);
+
+    // Check frequent rules first from now on (only if this cannot change which rule fires).
+    m_ruleSet.reorderByHits(frameRules);
+
+    return generateRulePoses(vecUseCounts, frameRules, m_generator);
+}
+
+std::vector<std::vector<Augmenter::Pose>> PoseGenerator::generateRulePoses(
+    const std::vector<uint32_t>& vecUseCounts,
+    const std::vector<int32_t>& frameRules,
+    std::mt19937_64& generator)
+{
+    uint32_t numFrames = vecUseCounts.size();
 
     // Generate Poses for each frame
     std::vector<std::vector<Augmenter::Pose>> vecVecPoses = {};
+    vecVecPoses.reserve(numFrames);
     for (uint32_t i = 0; i < numFrames; ++i)
     {
-        std::vector<Augmenter::Pose> Poses = generatePoses4oneFrame(vecUseCounts.at(i), i, trace);
-        vecVecPoses.push_back(Poses);
+        vecVecPoses.push_back(generatePoses4rule(vecUseCounts.at(i), i, frameRules[i], generator));
     }
 
     if (vecVecPoses.size() != numFrames) {
@@ -70,96 +158,797 @@ std::vector<std::vector<Augmenter::Pose>> PoseGenerator::generatePoses4vecFrames
     return vecVecPoses;
 }
 
+std::vector<int32_t> PoseGenerator::resolveFrameRules(const std::vector<uint32_t>& vecUseCounts,
+                                                      const std::string& labelsFileName) const
+{
+    uint32_t numFrames = vecUseCounts.size();
+
+    // Reject mismatched inputs from a newline count before paying for a full label load. A
+    // compressed trace would have to be inflated for the count too, so it is only checked
+    // after its single streaming load.
+    if (!GzipReader::isGzip(labelsFileName))
+    {
+        const uint32_t numRows = LabelTable::countRows(labelsFileName);
+        if (numRows != numFrames)
+        {
+            throw std::invalid_argument("Trace has " + std::to_string(numRows) + " frames, but use count has " +
+                                        std::to_string(numFrames) + " entries.");
+        }
+    }
+
+    POSEGEN_PROBE1(trace_load_start, numFrames);
+    [[maybe_unused]] const uint64_t loadStart = poseProbeTimestamp();
+
+    // Load only the label columns the rules refer to, and only for frames that need poses.
+    LabelTable labels(labelsFileName, m_ruleSet.getFieldNames(), vecUseCounts);
+
+    POSEGEN_PROBE2(trace_load_end, labels.getNumRows(), poseProbeTimestamp() - loadStart);
+
+    if (labels.getNumRows() != numFrames)
+    {
+        throw std::invalid_argument("Trace has " + std::to_string(labels.getNumRows()) +
+                                    " frames, but use count has " + std::to_string(numFrames) + " entries.");
+    }
+
+    // Find the first matching rule of every frame at once, column by column.
+    std::vector<int32_t> frameRules = m_ruleSet.resolve(labels);
+
+    // Frames that need no poses were not loaded and get no rule.
+    const int32_t fallback = getFallbackRule();
+    for (uint32_t i = 0; i < numFrames; ++i)
+    {
+        if (vecUseCounts[i] == 0)
+        {
+            frameRules[i] = RuleSet::kNoRule;
+        }
+        else if (frameRules[i] == RuleSet::kNoRule)
+        {
+            frameRules[i] = fallback;
+        }
+    }
+
+    // Report every uncovered frame at once instead of failing on the first one.
+    std::vector<RuleSet::frameRange> uncovered = RuleSet::findUncovered(frameRules, vecUseCounts);
+    if (!uncovered.empty())
+    {
+        throw std::runtime_error("no perturbation rule found for frames " + describeRanges(uncovered) +
+                                 " of \"" + labelsFileName + "\"");
+    }
+    return frameRules;
+}
+
+std::vector<RuleSet::frameRange> PoseGenerator::findUncoveredFrames(
+    const std::vector<uint32_t>& vecUseCounts,
+    const std::string& labelsFileName) const
+{
+    LabelTable labels(labelsFileName, m_ruleSet.getFieldNames(), vecUseCounts);
+    return RuleSet::findUncovered(m_ruleSet.resolve(labels), vecUseCounts);
+}
+
+void PoseGenerator::setFallbackRule(const perturbParams& params)
+{
+    m_ruleParams.resize(m_ruleSet.size());
+    m_ruleParams.push_back(params);
+    if (m_statistics)
+    {
+        enableStatistics(true);
+    }
+    if (m_latticeSteps)
+    {
+        buildLattice();
+    }
+}
+
+int32_t PoseGenerator::getFallbackRule() const
+{
+    return m_ruleParams.size() > m_ruleSet.size() ? static_cast<int32_t>(m_ruleSet.size())
+                                                  : RuleSet::kNoRule;
+}
+
 std::vector<Augmenter::Pose> PoseGenerator::generateShuffledPoses(
         std::vector<uint32_t> vecUseCounts,
         const std::string& labelsFileName)
 {
-    std::vector<std::vector<Augmenter::Pose>> unshuffledPoses = generatePoses4vecFrames(vecUseCounts, labelsFileName);
+    std::vector<int32_t> frameRules;
+    std::vector<std::vector<Augmenter::Pose>> unshuffledPoses =
+        generateFramePoses(vecUseCounts, labelsFileName, frameRules);
+    return orderPoses(unshuffledPoses, frameRules, m_generator);
+}
 
-    // Shuffle poses
-    std::vector<Augmenter::Pose> flattenedPoses;
-    for (const auto& vec : unshuffledPoses)
+std::vector<std::vector<Augmenter::Pose>> PoseGenerator::generateEpochs(
+    const std::vector<uint32_t>& vecUseCounts,
+    const std::string& labelsFileName,
+    uint32_t numEpochs)
+{
+    std::vector<std::vector<Augmenter::Pose>> epochs;
+    if (numEpochs == 0)
     {
-        for (const auto& pose : vec)
+        return epochs;
+    }
+    epochs.reserve(numEpochs);
+
+    // Labels are loaded and rules resolved once; every epoch only draws and orders poses.
+    std::vector<int32_t> frameRules = resolveFrameRules(vecUseCounts, labelsFileName);
+    m_ruleSet.reorderByHits(frameRules);
+    for (uint32_t epoch = 0; epoch < numEpochs; ++epoch)
+    {
+        std::vector<std::vector<Augmenter::Pose>> framePoses =
+            generateRulePoses(vecUseCounts, frameRules, m_generator);
+        epochs.push_back(orderPoses(framePoses, frameRules, m_generator));
+    }
+    return epochs;
+}
+
+PoseEnsemble PoseGenerator::generateEnsemble(const std::vector<uint32_t>& vecUseCounts,
+                                             const std::string& labelsFileName,
+                                             const std::vector<uint64_t>& seeds)
+{
+    m_ensembleStatistics.clear();
+    const size_t numLanes = seeds.size();
+    if (numLanes == 0)
+    {
+        return PoseEnsemble();
+    }
+
+    // Labels are loaded and rules resolved once for all seeds.
+    std::vector<int32_t> frameRules = resolveFrameRules(vecUseCounts, labelsFileName);
+    m_ruleSet.reorderByHits(frameRules);
+
+    // Slots are the poses of the frame-by-frame order; frame and flip state are the same in
+    // every set.
+    std::vector<std::vector<poseSlot>> frameSlots(vecUseCounts.size());
+    std::vector<uint32_t> srcFrames;
+    std::vector<uint8_t> flips;
+    for (uint32_t frame = 0; frame < vecUseCounts.size(); ++frame)
+    {
+        const int32_t rule = frameRules[frame];
+        if (vecUseCounts[frame] != 0 && rule == RuleSet::kNoRule)
+        {
+            throw std::runtime_error("no perturbation rule found for frame " + std::to_string(frame));
+        }
+        if (srcFrames.size() + vecUseCounts[frame] > UINT32_MAX)
         {
-            flattenedPoses.push_back(pose);
+            throw std::invalid_argument("use counts add up to more than " + std::to_string(UINT32_MAX) +
+                                        " poses per ensemble set");
+        }
+        for (uint32_t i = 0; i < vecUseCounts[frame]; ++i)
+        {
+            // Flip every other pose
+            const bool flip = m_ruleParams[rule].flip && i % 2;
+            frameSlots[frame].push_back({frame, flip, static_cast<uint32_t>(srcFrames.size())});
+            srcFrames.push_back(frame);
+            flips.push_back(flip);
         }
     }
-    if (flattenedPoses.size() == 0)
+
+    // Draw the values of all sets slot by slot, one SIMD lane per seed. A lane only advances
+    // its stream when it draws, so a set depends on its own seed alone.
+    const size_t numSlots  = srcFrames.size();
+    const size_t numFields = 3 + 3 * m_sensorNames.size();
+    std::vector<float> values(numSlots * numFields * numLanes);
+    EnsembleRandom random(seeds);
+    const std::vector<uint8_t> allLanes(numLanes, 1);
+    std::vector<uint8_t> invalid(numLanes);
+    std::vector<uint8_t> valid;
+    std::vector<double> uniforms(numLanes);
+    for (size_t slot = 0; slot < numSlots; ++slot)
     {
-        return {};
+        const int32_t rule = frameRules[srcFrames[slot]];
+        float* slotValues  = &values[slot * numFields * numLanes];
+        drawEnsemblePoses(random, rule, flips[slot], allLanes.data(), uniforms, slotValues);
+        // Lanes with invalid poses redraw them; valid lanes do not touch their streams.
+        for (uint32_t round = 0; m_validity; ++round)
+        {
+            m_validity->check(m_sensorNames, slotValues, slotValues + numLanes, slotValues + 2 * numLanes,
+                              slotValues + 3 * numLanes, numLanes, valid);
+            size_t numInvalid = 0;
+            for (size_t lane = 0; lane < numLanes; ++lane)
+            {
+                invalid[lane] = !valid[lane];
+                numInvalid += invalid[lane];
+            }
+            if (numInvalid == 0)
+            {
+                break;
+            }
+            if (round == kMaxResampleRounds)
+            {
+                throw std::runtime_error("no valid pose for frame " + std::to_string(srcFrames[slot]) +
+                                         " after " + std::to_string(kMaxResampleRounds) +
+                                         " resampling rounds; check the validity model against rule " +
+                                         std::to_string(rule));
+            }
+            m_numRejectedPoses += numInvalid;
+            drawEnsemblePoses(random, rule, flips[slot], invalid.data(), uniforms, slotValues);
+        }
+    }
+
+    // Order the slots of every set by the delivery mode, with a generator of its own seed,
+    // as generateShuffledPoses orders poses.
+    std::vector<uint32_t> orders(numSlots * numLanes);
+    std::vector<deliveryStatistics> statistics;
+    statistics.reserve(numLanes);
+    for (size_t lane = 0; lane < numLanes; ++lane)
+    {
+        std::vector<std::vector<poseSlot>> laneSlots = frameSlots;
+        std::mt19937_64 generator(seeds[lane]);
+        std::vector<poseSlot> ordered = orderByMode(laneSlots, frameRules, generator);
+        statistics.push_back(computeDeliveryStatistics(ordered, laneSlots));
+        for (size_t i = 0; i < numSlots; ++i)
+        {
+            orders[lane * numSlots + i] = ordered[i].slot;
+        }
+    }
+    m_ensembleStatistics.swap(statistics);
+    return PoseEnsemble(m_sensorNames, numLanes, std::move(srcFrames), std::move(flips), std::move(values),
+                        std::move(orders));
+}
+
+const std::vector<PoseGenerator::deliveryStatistics>& PoseGenerator::getEnsembleDeliveryStatistics() const
+{
+    return m_ensembleStatistics;
+}
+
+void PoseGenerator::drawEnsembleField(EnsembleRandom& random,
+                                      int32_t rule,
+                                      uint32_t field,
+                                      const randParams& params,
+                                      const uint8_t* active,
+                                      std::vector<double>& uniforms,
+                                      float* values)
+{
+    if (m_latticeSteps)
+    {
+        const latticeAxis& axis = m_latticeAxes[rule][field];
+        random.uniform01(active, uniforms.data());
+        for (size_t lane = 0; lane < random.size(); ++lane)
+        {
+            if (active[lane])
+            {
+                const double u = uniforms[lane] * axis.cumulative.back();
+                const size_t k = std::upper_bound(axis.cumulative.begin(), axis.cumulative.end(), u) -
+                                 axis.cumulative.begin();
+                values[lane] = axis.values[std::min(k, axis.values.size() - 1)];
+            }
+        }
+    }
+    else if ((params.distribution == "gaussian") || (params.distribution == "normal"))
+    {
+        random.gaussian(params.stdDev, params.max, active, values);
+    }
+    else if (params.distribution == "uniform")
+    {
+        random.uniform(params.max, active, values);
+    }
+    else
+    {
+        throw std::invalid_argument("Unknown distribution type: " + params.distribution);
+    }
+}
+
+void PoseGenerator::drawEnsemblePoses(EnsembleRandom& random,
+                                      int32_t rule,
+                                      bool flip,
+                                      const uint8_t* active,
+                                      std::vector<double>& uniforms,
+                                      float* values)
+{
+    // Fields in the draw order of generateOnePose, numLanes values apart.
+    const perturbParams& params = m_ruleParams[rule];
+    const size_t numLanes       = random.size();
+    drawEnsembleField(random, rule, PoseStatistics::Shift, params.shift, active, uniforms, values);
+    drawEnsembleField(random, rule, PoseStatistics::Rotation, params.rotation, active, uniforms,
+                      values + numLanes);
+    drawEnsembleField(random, rule, PoseStatistics::Forward, params.forward, active, uniforms,
+                      values + 2 * numLanes);
+    for (size_t s = 0; s < m_sensorNames.size(); ++s)
+    {
+        float* angles = values + (3 + 3 * s) * numLanes;
+        drawEnsembleField(random, rule, PoseStatistics::SensorYaw, params.sensor_yaw, active, uniforms,
+                          angles);
+        drawEnsembleField(random, rule, PoseStatistics::SensorPitch, params.sensor_pitch, active, uniforms,
+                          angles + numLanes);
+        drawEnsembleField(random, rule, PoseStatistics::SensorRoll, params.sensor_roll, active, uniforms,
+                          angles + 2 * numLanes);
+    }
+    // Values are kept as delivered, so flipped slots negate shift and rotation as flipPose().
+    for (size_t lane = 0; flip && lane < numLanes; ++lane)
+    {
+        if (active[lane])
+        {
+            values[lane] *= -1;
+            values[numLanes + lane] *= -1;
+        }
+    }
+}
+
+template <typename PoseT>
+std::vector<PoseT> PoseGenerator::orderByMode(std::vector<std::vector<PoseT>>& unshuffledPoses,
+                                              const std::vector<int32_t>& frameRules,
+                                              std::mt19937_64& generator)
+{
+    [[maybe_unused]] const uint64_t shuffleStart = poseProbeTimestamp();
+    std::vector<PoseT> flattenedPoses;
+    [[maybe_unused]] uint32_t reshuffles = 0;
+    if (m_deliveryMode == ShuffleGopBlocks)
+    {
+        if (m_keyframeOffsets.size() != unshuffledPoses.size())
+        {
+            throw std::invalid_argument("GOP index has " + std::to_string(m_keyframeOffsets.size()) +
+                                        " frames, but use count has " +
+                                        std::to_string(unshuffledPoses.size()) + " entries.");
+        }
+        POSEGEN_PROBE1(shuffle_start, unshuffledPoses.size());
+        flattenedPoses = orderGopBlocks(unshuffledPoses, generator);
+    }
+    else if (m_deliveryMode == ShuffleStrata)
+    {
+        POSEGEN_PROBE1(shuffle_start, unshuffledPoses.size());
+        flattenedPoses = orderStrata(unshuffledPoses, frameRules, generator);
     }
-    // TODO: we should shuffle on disk instead of here (saves time re-reading/decoding h264)
-    std::shuffle(flattenedPoses.begin(), flattenedPoses.end(), m_generator);
-    // TODO: The augmenter crashes if the first pose is fipped - we should fix this
-    while (flattenedPoses.at(0).flip)
+    else if (m_deliveryMode == ShuffleFrameGroups)
     {
-        std::shuffle(flattenedPoses.begin(), flattenedPoses.end(), m_generator);
+        // Shuffle frames, keeping the poses of a frame together in generation order; the
+        // first pose of a frame is never flipped, so neither is the first pose overall.
+        std::vector<uint32_t> frames;
+        size_t numPoses = 0;
+        for (uint32_t i = 0; i < unshuffledPoses.size(); ++i)
+        {
+            if (!unshuffledPoses[i].empty())
+            {
+                frames.push_back(i);
+                numPoses += unshuffledPoses[i].size();
+            }
+        }
+        flattenedPoses.reserve(numPoses);
+        POSEGEN_PROBE1(shuffle_start, frames.size());
+        std::shuffle(frames.begin(), frames.end(), generator);
+        for (uint32_t frame : frames)
+        {
+            flattenedPoses.insert(flattenedPoses.end(), unshuffledPoses[frame].begin(),
+                                  unshuffledPoses[frame].end());
+        }
+    }
+    else
+    {
+        // Shuffle poses
+        for (const auto& vec : unshuffledPoses)
+        {
+            for (const auto& pose : vec)
+            {
+                flattenedPoses.push_back(pose);
+            }
+        }
+        if (flattenedPoses.size() != 0)
+        {
+            POSEGEN_PROBE1(shuffle_start, flattenedPoses.size());
+            // TODO: we should shuffle on disk instead of here (saves time re-reading/decoding h264)
+            std::shuffle(flattenedPoses.begin(), flattenedPoses.end(), generator);
+            // TODO: The augmenter crashes if the first pose is fipped - we should fix this
+            while (flattenedPoses.at(0).flip)
+            {
+                ++reshuffles;
+                POSEGEN_PROBE2(reshuffle_retry, reshuffles, flattenedPoses.size());
+                std::shuffle(flattenedPoses.begin(), flattenedPoses.end(), generator);
+            }
+        }
     }
+    POSEGEN_PROBE3(shuffle_end, flattenedPoses.size(), poseProbeTimestamp() - shuffleStart,
+                   reshuffles);
     return flattenedPoses;
 }
 
+template <typename PoseT>
+PoseGenerator::deliveryStatistics PoseGenerator::computeDeliveryStatistics(
+    const std::vector<PoseT>& orderedPoses,
+    const std::vector<std::vector<PoseT>>& framePoses) const
+{
+    // Count the frame decodes this order costs the Augmenter.
+    deliveryStatistics statistics = {orderedPoses.size(), 0, 0, 0};
+    for (size_t i = 0; i < orderedPoses.size(); ++i)
+    {
+        if (i == 0 || orderedPoses[i].srcFrame != orderedPoses[i - 1].srcFrame)
+        {
+            ++statistics.numDecodes;
+        }
+    }
+    for (const auto& vec : framePoses)
+    {
+        statistics.numFrames += !vec.empty();
+    }
+    if (m_keyframeOffsets.size() == framePoses.size())
+    {
+        statistics.decodeCost = decodeCost(orderedPoses, m_keyframeOffsets);
+    }
+    return statistics;
+}
+
+std::vector<Augmenter::Pose> PoseGenerator::orderPoses(
+    std::vector<std::vector<Augmenter::Pose>>& unshuffledPoses,
+    const std::vector<int32_t>& frameRules,
+    std::mt19937_64& generator)
+{
+    std::vector<Augmenter::Pose> flattenedPoses = orderByMode(unshuffledPoses, frameRules, generator);
+    m_deliveryStatistics = computeDeliveryStatistics(flattenedPoses, unshuffledPoses);
+    computePoseOutputs(flattenedPoses);
+    return flattenedPoses;
+}
+
+template <typename PoseT>
+std::vector<PoseT> PoseGenerator::orderGopBlocks(const std::vector<std::vector<PoseT>>& framePoses,
+                                                 std::mt19937_64& generator)
+{
+    // Cut the randomly ordered poses of every GOP into blocks, each sorted by frame. Within a
+    // frame unflipped poses come first.
+    auto byFrame = [](const PoseT& a, const PoseT& b) {
+        return a.srcFrame != b.srcFrame ? a.srcFrame < b.srcFrame : !a.flip && b.flip;
+    };
+    std::vector<PoseT> gopPoses;
+    std::vector<PoseT> blockedPoses;
+    std::vector<std::pair<size_t, size_t>> blocks;
+    for (uint32_t frame = 0; frame < framePoses.size();)
+    {
+        const uint32_t keyframe = frame - m_keyframeOffsets[frame];
+        gopPoses.clear();
+        for (; frame < framePoses.size() && frame - m_keyframeOffsets[frame] == keyframe; ++frame)
+        {
+            gopPoses.insert(gopPoses.end(), framePoses[frame].begin(), framePoses[frame].end());
+        }
+        std::shuffle(gopPoses.begin(), gopPoses.end(), generator);
+        for (size_t begin = 0; begin < gopPoses.size(); begin += m_maxBlockPoses)
+        {
+            const size_t end = std::min<size_t>(begin + m_maxBlockPoses, gopPoses.size());
+            blocks.push_back({blockedPoses.size(), blockedPoses.size() + end - begin});
+            blockedPoses.insert(blockedPoses.end(), gopPoses.begin() + begin, gopPoses.begin() + end);
+            std::sort(blockedPoses.begin() + blocks.back().first, blockedPoses.end(), byFrame);
+        }
+    }
+    if (blocks.empty())
+    {
+        return {};
+    }
+    std::shuffle(blocks.begin(), blocks.end(), generator);
+
+    // The Augmenter cannot start with a flipped pose: lead with a block that starts unflipped,
+    // or else move an unflipped pose to the front of a block and lead with that one.
+    auto isUnflipped   = [](const PoseT& pose) { return !pose.flip; };
+    auto startsUnflipped = [&](const std::pair<size_t, size_t>& block) {
+        return isUnflipped(blockedPoses[block.first]);
+    };
+    auto lead = std::find_if(blocks.begin(), blocks.end(), startsUnflipped);
+    for (auto block = blocks.begin(); lead == blocks.end() && block != blocks.end(); ++block)
+    {
+        auto first     = blockedPoses.begin() + block->first;
+        auto unflipped = std::find_if(first, blockedPoses.begin() + block->second, isUnflipped);
+        if (unflipped != blockedPoses.begin() + block->second)
+        {
+            std::rotate(first, unflipped, unflipped + 1);
+            lead = block;
+        }
+    }
+    if (lead != blocks.end())
+    {
+        std::swap(blocks.front(), *lead);
+    }
+
+    std::vector<PoseT> orderedPoses;
+    orderedPoses.reserve(blockedPoses.size());
+    for (const auto& block : blocks)
+    {
+        orderedPoses.insert(orderedPoses.end(), blockedPoses.begin() + block.first,
+                            blockedPoses.begin() + block.second);
+    }
+    return orderedPoses;
+}
+
+template <typename PoseT>
+std::vector<PoseT> PoseGenerator::orderStrata(std::vector<std::vector<PoseT>>& framePoses,
+                                              const std::vector<int32_t>& frameRules,
+                                              std::mt19937_64& generator)
+{
+    // Stratum 2 * rule + flip; poses of frames without rule do not exist.
+    std::vector<std::vector<PoseT>> strata(2 * m_ruleParams.size());
+    size_t numPoses = 0;
+    for (size_t frame = 0; frame < framePoses.size(); ++frame)
+    {
+        for (auto& pose : framePoses[frame])
+        {
+            strata[2 * frameRules[frame] + pose.flip].push_back(std::move(pose));
+        }
+        numPoses += framePoses[frame].size();
+    }
+
+    // Deficit round-robin merge: the k-th pose of a stratum of size m is due at position
+    // (k + phase) * n / m, and poses are placed in the order they are due. A counting sort
+    // over the due positions does that in O(n) for any number of strata; the random phase
+    // keeps small strata from always leading their window.
+    std::uniform_real_distribution<double> phaseDistribution(0.0, 1.0);
+    std::vector<double> phases(strata.size());
+    std::vector<uint32_t> starts(numPoses + 1, 0);
+    auto due = [&](size_t s, size_t k) {
+        return std::min<size_t>(numPoses - 1, (k + phases[s]) * numPoses / strata[s].size());
+    };
+    for (size_t s = 0; s < strata.size(); ++s)
+    {
+        std::shuffle(strata[s].begin(), strata[s].end(), generator);
+        phases[s] = phaseDistribution(generator);
+        for (size_t k = 0; k < strata[s].size(); ++k)
+        {
+            ++starts[due(s, k) + 1];
+        }
+    }
+    std::partial_sum(starts.begin(), starts.end(), starts.begin());
+    std::vector<PoseT> ordered(numPoses);
+    for (size_t s = 0; s < strata.size(); ++s)
+    {
+        for (size_t k = 0; k < strata[s].size(); ++k)
+        {
+            ordered[starts[due(s, k)]++] = std::move(strata[s][k]);
+        }
+    }
+
+    // The Augmenter cannot start with a flipped pose: move the first unflipped one up front.
+    auto unflipped =
+        std::find_if(ordered.begin(), ordered.end(), [](const PoseT& pose) { return !pose.flip; });
+    if (unflipped != ordered.end())
+    {
+        std::rotate(ordered.begin(), unflipped, unflipped + 1);
+    }
+    return ordered;
+}
+
+uint64_t PoseGenerator::computeDecodeCost(const std::vector<Augmenter::Pose>& poses,
+                                          const std::vector<uint32_t>& keyframeOffsets)
+{
+    return decodeCost(poses, keyframeOffsets);
+}
+
+void PoseGenerator::setGopIndex(const std::vector<uint32_t>& keyframeOffsets)
+{
+    for (uint32_t frame = 0; frame < keyframeOffsets.size(); ++frame)
+    {
+        if (keyframeOffsets[frame] > frame)
+        {
+            throw std::invalid_argument("keyframe offset " + std::to_string(keyframeOffsets[frame]) +
+                                        " of frame " + std::to_string(frame) + " is before the first frame");
+        }
+    }
+    m_keyframeOffsets = keyframeOffsets;
+}
+
+void PoseGenerator::setGopIndex(const std::string& gopIndexFileName)
+{
+    std::ifstream in(gopIndexFileName);
+    if (!in)
+    {
+        throw std::runtime_error("cannot open GOP index \"" + gopIndexFileName + "\"");
+    }
+    std::vector<uint32_t> keyframeOffsets;
+    std::string line;
+    while (std::getline(in, line))
+    {
+        const size_t begin = line.find_first_not_of(" \t\r");
+        if (begin == std::string::npos || line[begin] == '#')
+        {
+            continue;
+        }
+        char* end                 = nullptr;
+        const unsigned long value = std::strtoul(line.c_str() + begin, &end, 10);
+        const size_t parsed = end - line.c_str();
+        if (parsed == begin || line.find_first_not_of(" \t\r", parsed) != std::string::npos)
+        {
+            throw std::invalid_argument("invalid keyframe offset \"" + line + "\" in \"" + gopIndexFileName +
+                                        "\"");
+        }
+        keyframeOffsets.push_back(static_cast<uint32_t>(value));
+    }
+    setGopIndex(keyframeOffsets);
+}
+
+std::vector<Augmenter::Pose> PoseGenerator::generateShuffledPoses(
+        std::vector<uint32_t> vecUseCounts,
+        const std::string& labelsFileName,
+        std::vector<uint32_t>& nextUse)
+{
+    std::vector<Augmenter::Pose> poses = generateShuffledPoses(std::move(vecUseCounts), labelsFileName);
+    nextUse = computeNextUse(poses);
+    return poses;
+}
+
+std::vector<uint32_t> PoseGenerator::computeNextUse(const std::vector<Augmenter::Pose>& poses)
+{
+    uint32_t numFrames = 0;
+    for (const auto& pose : poses)
+    {
+        numFrames = std::max(numFrames, pose.srcFrame + 1);
+    }
+    // Walk backwards, remembering where every frame is used next.
+    std::vector<uint32_t> nextUseOfFrame(numFrames, kNoReuse);
+    std::vector<uint32_t> nextUse(poses.size());
+    for (size_t i = poses.size(); i-- > 0;)
+    {
+        nextUse[i]                        = nextUseOfFrame[poses[i].srcFrame];
+        nextUseOfFrame[poses[i].srcFrame] = static_cast<uint32_t>(i);
+    }
+    return nextUse;
+}
+
+void PoseGenerator::setDeliveryMode(DeliveryMode mode, uint32_t maxBlockPoses)
+{
+    m_deliveryMode  = mode;
+    m_maxBlockPoses = std::max(1u, maxBlockPoses);
+}
+
+const PoseGenerator::deliveryStatistics& PoseGenerator::getDeliveryStatistics() const
+{
+    return m_deliveryStatistics;
+}
+
+std::vector<Augmenter::Pose> PoseGenerator::generatePoses4oneFrame(
+    uint32_t useCount,
+    uint32_t index,
+    const LabelTable& labels)
+{
+    if (useCount == 0)
+    {
+        return {};
+    }
+
+    // Find the first rule that applies to this frame among many rules.
+    int32_t rule = m_ruleSet.resolveRow(labels, index);
+    return generatePoses4rule(useCount, index, rule == RuleSet::kNoRule ? getFallbackRule() : rule,
+                              m_generator);
+}
+
 std::vector<Augmenter::Pose> PoseGenerator::generatePoses4oneFrame(
     uint32_t useCount,
     uint32_t index,
     const projMetaData::projMetaTrace& trace)
+{
+    if (useCount == 0)
+    {
+        return {};
+    }
+
+    // Find the first rule that applies to this frame among many rules.
+    int32_t rule = m_ruleSet.resolveRow(trace, index);
+    return generatePoses4rule(useCount, index, rule == RuleSet::kNoRule ? getFallbackRule() : rule,
+                              m_generator);
+}
+
+std::vector<Augmenter::Pose> PoseGenerator::generatePoses4rule(uint32_t useCount,
+                                                               uint32_t index,
+                                                               int32_t rule,
+                                                               std::mt19937_64& generator)
 {
     std::vector<Augmenter::Pose> vecPoses = {};
     if (useCount == 0)
     {
         return vecPoses;
     }
+    [[maybe_unused]] const uint64_t frameStart = poseProbeTimestamp();
 
-    // Find the first rule that applies to this frame among many rules.
-    auto first_rule = std::find_if(m_perturbRules.begin(),
-                                   m_perturbRules.end(),
-                                   [&](std::pair<std::map<std::string, std::string>, perturbParams> rule) {
-                                       return trace.doLabelsMatch(index, rule.first);
-                                   });
+    POSEGEN_PROBE2(rule_resolved, index, rule);
 
-    if (first_rule != m_perturbRules.end())
+    if (rule != RuleSet::kNoRule)
     {
+        const perturbParams& params = m_ruleParams[rule];
+        vecPoses.reserve(useCount);
         for (uint32_t i = 0; i < useCount; ++i)
         {
-            Augmenter::Pose onePose = generateOnePose(first_rule[0].second);
-            onePose.srcFrame = index;
-            // Push flipped pose every other pose
-            if (first_rule[0].second.flip && i % 2)
-            {
-                vecPoses.push_back(flipPose(onePose));
-            }
-            else
+            vecPoses.push_back(m_latticeSteps ? generateLatticePose(rule, generator)
+                                              : generateOnePose(params, generator));
+            vecPoses.back().srcFrame = index;
+            // Flip every other pose
+            if (params.flip && i % 2)
             {
-                vecPoses.push_back(onePose);
+                vecPoses.back() = flipPose(vecPoses.back());
             }
         }
+        if (m_validity)
+        {
+            // Poses are checked as delivered, flipped ones after flipping.
+            resampleInvalidPoses(vecPoses, index, rule, generator);
+        }
+        for (uint32_t i = 0; m_statistics && i < useCount; ++i)
+        {
+            m_statistics->addPose(rule, vecPoses[i]);
+        }
     }
 
     if (vecPoses.size() == 0)
     {
-        throw std::runtime_error("no perturbation rule found for frame " + index);
+        throw std::runtime_error("no perturbation rule found for frame " + std::to_string(index));
     }
+    POSEGEN_PROBE3(frame_generated, index, useCount, poseProbeTimestamp() - frameStart);
 
     return vecPoses;
 }
 
+void PoseGenerator::resampleInvalidPoses(std::vector<Augmenter::Pose>& poses,
+                                         uint32_t index,
+                                         int32_t rule,
+                                         std::mt19937_64& generator)
+{
+    // Check the whole frame at once, then only the replacements of rejected poses.
+    std::vector<uint32_t> pending(poses.size());
+    std::iota(pending.begin(), pending.end(), 0);
+    std::vector<Augmenter::Pose> batch = poses;
+    std::vector<uint8_t> valid;
+    for (uint32_t round = 0; round < kMaxResampleRounds; ++round)
+    {
+        m_validity->check(batch, valid);
+        std::vector<uint32_t> rejected;
+        batch.clear();
+        for (size_t j = 0; j < pending.size(); ++j)
+        {
+            if (!valid[j])
+            {
+                Augmenter::Pose& pose = poses[pending[j]];
+                pose = m_latticeSteps ? generateLatticePose(rule, generator)
+                                      : generateOnePose(m_ruleParams[rule], generator);
+                pose.srcFrame = index;
+                // A replacement takes the place, and so the flip, of the rejected pose.
+                if (m_ruleParams[rule].flip && pending[j] % 2)
+                {
+                    pose = flipPose(pose);
+                }
+                rejected.push_back(pending[j]);
+                batch.push_back(pose);
+            }
+        }
+        m_numRejectedPoses += rejected.size();
+        if (rejected.empty())
+        {
+            return;
+        }
+        pending.swap(rejected);
+    }
+    throw std::runtime_error("no valid pose for frame " + std::to_string(index) + " after " +
+                             std::to_string(kMaxResampleRounds) +
+                             " resampling rounds; check the validity model against rule " +
+                             std::to_string(rule));
+}
+
+void PoseGenerator::setValidityModel(const PoseValidity& validity)
+{
+    if (validity.empty())
+    {
+        m_validity.reset();
+    }
+    else
+    {
+        m_validity = validity;
+    }
+}
+
+uint64_t PoseGenerator::getNumRejectedPoses() const
+{
+    return m_numRejectedPoses;
+}
+
 Augmenter::Pose PoseGenerator::generateOnePose(const perturbParams& params)
+{
+    return generateOnePose(params, m_generator);
+}
+
+Augmenter::Pose PoseGenerator::generateOnePose(const perturbParams& params, std::mt19937_64& generator)
 {
     Augmenter::Pose aPose = {};
 
     // Get random numbers for shift, rotation, and forward.
-    aPose.shift    = getRandom(params.shift);
-    aPose.rotation = getRandom(params.rotation);
-    aPose.forward  = getRandom(params.forward);
+    aPose.shift    = getRandom(params.shift, generator);
+    aPose.rotation = getRandom(params.rotation, generator);
+    aPose.forward  = getRandom(params.forward, generator);
 
     // Get random numbers for sensor_yaw, sensor_pitch, and sensor_roll for given sensors.
     for (auto sensorName : m_sensorNames)
     {
-        float amountSensor_yaw = getRandom(params.sensor_yaw);
+        float amountSensor_yaw = getRandom(params.sensor_yaw, generator);
         aPose.sensor_yaw.insert(std::pair<std::string, float>(sensorName, amountSensor_yaw));
-        float amountSensor_pitch = getRandom(params.sensor_pitch);
+        float amountSensor_pitch = getRandom(params.sensor_pitch, generator);
         aPose.sensor_pitch.insert(std::pair<std::string, float>(sensorName, amountSensor_pitch));
-        float amountSensor_roll = getRandom(params.sensor_roll);
+        float amountSensor_roll = getRandom(params.sensor_roll, generator);
         aPose.sensor_roll.insert(std::pair<std::string, float>(sensorName, amountSensor_roll));
     }
     aPose.flip = false;
@@ -167,6 +956,207 @@ Augmenter::Pose PoseGenerator::generateOnePose(const perturbParams& params)
     return aPose;
 }
 
+void PoseGenerator::enableStatistics(bool enable)
+{
+    if (!enable)
+    {
+        m_statistics.reset();
+        return;
+    }
+    // Histogram ranges follow the hard limits of each rule.
+    std::vector<std::array<double, PoseStatistics::NumFields>> limits;
+    for (const perturbParams& p : m_ruleParams)
+    {
+        limits.push_back({p.shift.max, p.rotation.max, p.forward.max, p.sensor_yaw.max,
+                          p.sensor_pitch.max, p.sensor_roll.max});
+    }
+    m_statistics.emplace(limits);
+}
+
+void PoseGenerator::enableSensorRotations(bool enable)
+{
+    if (enable)
+    {
+        m_sensorRotations.emplace();
+    }
+    else
+    {
+        m_sensorRotations.reset();
+    }
+}
+
+const SensorRotations* PoseGenerator::getSensorRotations() const
+{
+    return m_sensorRotations ? &m_sensorRotations.value() : nullptr;
+}
+
+void PoseGenerator::computePoseOutputs(const std::vector<Augmenter::Pose>& poses)
+{
+    if (m_sensorRotations)
+    {
+        m_sensorRotations = SensorRotations(poses, m_sensorNames);
+    }
+    m_latticeKeys.clear();
+    if (m_latticeSteps)
+    {
+        m_latticeKeys.reserve(poses.size());
+        for (const auto& pose : poses)
+        {
+            m_latticeKeys.push_back(computeLatticeKey(pose));
+        }
+    }
+}
+
+void PoseGenerator::setLatticeMode(uint32_t stepsPerSide)
+{
+    m_latticeSteps = stepsPerSide;
+    m_latticeKeys.clear();
+    buildLattice();
+}
+
+const std::vector<uint64_t>& PoseGenerator::getLatticeKeys() const
+{
+    return m_latticeKeys;
+}
+
+void PoseGenerator::buildLattice()
+{
+    m_latticeAxes.clear();
+    if (!m_latticeSteps)
+    {
+        return;
+    }
+    for (const perturbParams& p : m_ruleParams)
+    {
+        m_latticeAxes.push_back({buildLatticeAxis(p.shift), buildLatticeAxis(p.rotation),
+                                 buildLatticeAxis(p.forward), buildLatticeAxis(p.sensor_yaw),
+                                 buildLatticeAxis(p.sensor_pitch), buildLatticeAxis(p.sensor_roll)});
+    }
+}
+
+PoseGenerator::latticeAxis PoseGenerator::buildLatticeAxis(const randParams& params) const
+{
+    // Cumulative distribution of the untruncated distribution; truncation to (-max, max) only
+    // rescales the cell probabilities.
+    std::function<double(double)> cdf;
+    if ((params.distribution == "gaussian") || (params.distribution == "normal"))
+    {
+        const double scale = params.stdDev * std::sqrt(2.0);
+        cdf                = [scale](double x) {
+            return scale > 0 ? 0.5 * std::erfc(-x / scale) : (x >= 0 ? 1.0 : 0.0);
+        };
+    }
+    else if (params.distribution == "uniform")
+    {
+        cdf = [](double x) { return x; };
+    }
+    else
+    {
+        throw std::invalid_argument("Unknown distribution type: " + params.distribution);
+    }
+
+    latticeAxis axis;
+    if (params.max <= 0)
+    {
+        axis.values     = {0.0f};
+        axis.cumulative = {1.0};
+        return axis;
+    }
+    // Point k * step owns the cell ((k - 0.5) * step, (k + 0.5) * step), cut at the bounds.
+    const int32_t steps = static_cast<int32_t>(m_latticeSteps);
+    const double step   = params.max / steps;
+    double total        = 0;
+    for (int32_t k = -steps; k <= steps; ++k)
+    {
+        const double low  = std::max(-params.max, (k - 0.5) * step);
+        const double high = std::min(params.max, (k + 0.5) * step);
+        total += std::max(0.0, cdf(high) - cdf(low));
+        axis.values.push_back(static_cast<float>(k * step));
+        axis.cumulative.push_back(total);
+    }
+    if (!(total > 0))
+    {
+        throw std::invalid_argument("Distribution has no probability within its hard limit.");
+    }
+    return axis;
+}
+
+float PoseGenerator::getLatticeRandom(const latticeAxis& axis, std::mt19937_64& generator)
+{
+    std::uniform_real_distribution<double> distribution_unif(0, axis.cumulative.back());
+    const double u = distribution_unif(generator);
+    const size_t k =
+        std::upper_bound(axis.cumulative.begin(), axis.cumulative.end(), u) - axis.cumulative.begin();
+    return axis.values[std::min(k, axis.values.size() - 1)];
+}
+
+Augmenter::Pose PoseGenerator::generateLatticePose(int32_t rule, std::mt19937_64& generator)
+{
+    const auto& axes      = m_latticeAxes[rule];
+    Augmenter::Pose aPose = {};
+    aPose.shift           = getLatticeRandom(axes[PoseStatistics::Shift], generator);
+    aPose.rotation        = getLatticeRandom(axes[PoseStatistics::Rotation], generator);
+    aPose.forward         = getLatticeRandom(axes[PoseStatistics::Forward], generator);
+    for (const auto& sensorName : m_sensorNames)
+    {
+        aPose.sensor_yaw[sensorName]   = getLatticeRandom(axes[PoseStatistics::SensorYaw], generator);
+        aPose.sensor_pitch[sensorName] = getLatticeRandom(axes[PoseStatistics::SensorPitch], generator);
+        aPose.sensor_roll[sensorName]  = getLatticeRandom(axes[PoseStatistics::SensorRoll], generator);
+    }
+    aPose.flip = false;
+    return aPose;
+}
+
+uint64_t PoseGenerator::computeLatticeKey(const Augmenter::Pose& pose)
+{
+    // FNV-1a over the bytes of every value; -0 and 0 hash alike (flipping negates zeros).
+    uint64_t hash  = 14695981039346656037ull;
+    auto hashBytes = [&hash](const void* data, size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        }
+    };
+    auto hashValue = [&hashBytes](float value) {
+        uint32_t bits      = 0;
+        const float zeroed = value == 0.0f ? 0.0f : value;
+        std::memcpy(&bits, &zeroed, sizeof(bits));
+        hashBytes(&bits, sizeof(bits));
+    };
+    hashValue(pose.shift);
+    hashValue(pose.rotation);
+    hashValue(pose.forward);
+    const unsigned char flip = pose.flip;
+    hashBytes(&flip, 1);
+    for (const auto* angles : {&pose.sensor_yaw, &pose.sensor_pitch, &pose.sensor_roll})
+    {
+        // Maps are ordered by sensor name, so the key does not depend on insertion order.
+        for (const auto& angle : *angles)
+        {
+            hashBytes(angle.first.data(), angle.first.size() + 1);
+            hashValue(angle.second);
+        }
+    }
+    return hash;
+}
+
+const PoseStatistics* PoseGenerator::getStatistics() const
+{
+    return m_statistics ? &m_statistics.value() : nullptr;
+}
+
+std::string PoseGenerator::reportStatistics(uint32_t epoch)
+{
+    if (!m_statistics)
+    {
+        return "";
+    }
+    std::string report = m_statistics->report(epoch);
+    m_statistics->reset();
+    return report;
+}
+
 Augmenter::Pose PoseGenerator::flipPose(const Augmenter::Pose& in)
 {
     // When flipping a pose, signs of shift and rotation change.
@@ -178,16 +1168,16 @@ Augmenter::Pose PoseGenerator::flipPose(const Augmenter::Pose& in)
     return pose;
 }
 
-float PoseGenerator::getRandom(const randParams& rParams)
+float PoseGenerator::getRandom(const randParams& rParams, std::mt19937_64& generator)
 {
     float num = 0;
     if ((rParams.distribution == "gaussian") || (rParams.distribution == "normal"))
     {
-        num = genGaussianRV(rParams);
+        num = genGaussianRV(rParams, generator);
     }
     else if (rParams.distribution == "uniform")
     {
-        num = genUniformRV(rParams);
+        num = genUniformRV(rParams, generator);
     }
     else
     {
@@ -197,27 +1187,33 @@ float PoseGenerator::getRandom(const randParams& rParams)
     return num;
 }
 
-float PoseGenerator::genGaussianRV(const randParams& params)
+float PoseGenerator::genGaussianRV(const randParams& params, std::mt19937_64& generator)
 {
 
     // Produce a random number according to a Gaussian distribution while making sure
     // that the number is bounded (-max, max).
     const double meanDist = 0;
     std::normal_distribution<double> distribution_norm(meanDist, params.stdDev);
-    double numGauss = distribution_norm(m_generator);
+    double numGauss = distribution_norm(generator);
+    uint32_t retries = 0;
     while ((numGauss < -params.max) || (numGauss > params.max))
     {
-        numGauss = distribution_norm(m_generator);
+        numGauss = distribution_norm(generator);
+        ++retries;
+    }
+    if (retries > 0)
+    {
+        POSEGEN_PROBE1(gaussian_retry, retries);
     }
 
     return numGauss;
 }
 
-float PoseGenerator::genUniformRV(const randParams& params)
+float PoseGenerator::genUniformRV(const randParams& params, std::mt19937_64& generator)
 {
     // Produce a random number according to a uniform distribution.
     std::uniform_real_distribution<double> distribution_unif(-params.max, params.max);
-    double numUnif = distribution_unif(m_generator);
+    double numUnif = distribution_unif(generator);
 
     return numUnif;
 }
@@ -0,0 +1,204 @@
+/*******************************************************************************
+ *
+ * @file poseStatistics.cpp
+ *
+ ******************************************************************************/
+
+#include <algorithm> // for min(), max()
+#include <cmath>     // for sqrt()
+#include <cstdio>    // for snprintf()
+#include <limits>    // for numeric_limits
+
+#include "poseStatistics.hpp"
+
+PoseStatistics::fieldAccumulator::fieldAccumulator(double limit)
+    : m_blockCount(0), m_limit(limit), m_summary{}
+{
+    m_summary.min = std::numeric_limits<float>::max();
+    m_summary.max = std::numeric_limits<float>::lowest();
+}
+
+void PoseStatistics::fieldAccumulator::flush()
+{
+    if (m_blockCount == 0)
+    {
+        return;
+    }
+    const uint32_t n = m_blockCount;
+    const float* block = m_block.data();
+
+    // Block moments: two passes over a contiguous buffer, no data-dependent branches.
+    double sum = 0;
+    float blockMin = block[0];
+    float blockMax = block[0];
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        sum += block[i];
+        blockMin = std::min(blockMin, block[i]);
+        blockMax = std::max(blockMax, block[i]);
+    }
+    const double blockMean = sum / n;
+    double blockM2 = 0;
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        const double d = block[i] - blockMean;
+        blockM2 += d * d;
+    }
+
+    // Histogram over (-limit, limit); values on or beyond the limits land in the edge bins.
+    // A zero limit (constant field) puts everything into the middle bin.
+    std::array<uint32_t, kBlockSize> bins;
+    const float limit = static_cast<float>(std::max(m_limit, 0.0));
+    const float scale = limit > 0 ? kNumBins / (2 * limit) : 0.f;
+    const float center = limit > 0 ? 0.f : kNumBins / 2;
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        float pos = (block[i] + limit) * scale + center;
+        pos = std::min(std::max(pos, 0.f), static_cast<float>(kNumBins - 1));
+        bins[i] = static_cast<uint32_t>(pos);
+    }
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        ++m_summary.histogram[bins[i]];
+    }
+
+    // Merge block into the running moments (Chan et al.).
+    const double count = static_cast<double>(m_summary.count);
+    const double total = count + n;
+    const double delta = blockMean - m_summary.mean;
+    const double m2 = m_summary.variance * count + blockM2 + delta * delta * count * n / total;
+    m_summary.mean += delta * n / total;
+    m_summary.variance = m2 / total;
+    m_summary.count += n;
+    m_summary.min = std::min(m_summary.min, blockMin);
+    m_summary.max = std::max(m_summary.max, blockMax);
+
+    m_blockCount = 0;
+}
+
+PoseStatistics::fieldSummary PoseStatistics::fieldAccumulator::summary() const
+{
+    fieldAccumulator copy = *this;
+    copy.flush();
+    return copy.m_summary;
+}
+
+PoseStatistics::PoseStatistics(const std::vector<std::array<double, NumFields>>& limits)
+    : m_limits(limits)
+{
+    reset();
+}
+
+void PoseStatistics::reset()
+{
+    m_rules.clear();
+    for (const auto& ruleLimits : m_limits)
+    {
+        ruleStatistics rule;
+        rule.numPoses   = 0;
+        rule.numFlipped = 0;
+        for (int f = 0; f < NumFields; ++f)
+        {
+            rule.fields[f] = fieldAccumulator(ruleLimits[f]);
+        }
+        m_rules.push_back(rule);
+    }
+}
+
+void PoseStatistics::addPose(uint32_t rule, const Augmenter::Pose& pose)
+{
+    ruleStatistics& stats = m_rules.at(rule);
+    stats.fields[Shift].add(pose.shift);
+    stats.fields[Rotation].add(pose.rotation);
+    stats.fields[Forward].add(pose.forward);
+    for (const auto& sensor : pose.sensor_yaw)
+    {
+        stats.fields[SensorYaw].add(sensor.second);
+    }
+    for (const auto& sensor : pose.sensor_pitch)
+    {
+        stats.fields[SensorPitch].add(sensor.second);
+    }
+    for (const auto& sensor : pose.sensor_roll)
+    {
+        stats.fields[SensorRoll].add(sensor.second);
+    }
+    ++stats.numPoses;
+    stats.numFlipped += pose.flip ? 1 : 0;
+}
+
+PoseStatistics::fieldSummary PoseStatistics::summary(uint32_t rule, Field field) const
+{
+    return m_rules.at(rule).fields[field].summary();
+}
+
+uint64_t PoseStatistics::numPoses(uint32_t rule) const
+{
+    return m_rules.at(rule).numPoses;
+}
+
+double PoseStatistics::flipRatio(uint32_t rule) const
+{
+    const ruleStatistics& stats = m_rules.at(rule);
+    return stats.numPoses ? static_cast<double>(stats.numFlipped) / stats.numPoses : 0.0;
+}
+
+uint32_t PoseStatistics::numRules() const
+{
+    return m_rules.size();
+}
+
+std::string PoseStatistics::report(uint32_t epoch) const
+{
+    std::string out;
+    char line[256];
+    for (uint32_t r = 0; r < m_rules.size(); ++r)
+    {
+        if (m_rules[r].numPoses == 0)
+        {
+            continue;
+        }
+        std::snprintf(line, sizeof(line), "epoch=%u rule=%u poses=%llu flip=%.3f\n", epoch, r,
+                      static_cast<unsigned long long>(m_rules[r].numPoses), flipRatio(r));
+        out += line;
+        for (int f = 0; f < NumFields; ++f)
+        {
+            fieldSummary s = summary(r, static_cast<Field>(f));
+            if (s.count == 0)
+            {
+                continue;
+            }
+            std::snprintf(line, sizeof(line), "  %s n=%llu mean=%.4f std=%.4f min=%.4f max=%.4f hist=",
+                          fieldName(static_cast<Field>(f)), static_cast<unsigned long long>(s.count),
+                          s.mean, std::sqrt(s.variance), s.min, s.max);
+            out += line;
+            for (uint32_t b = 0; b < kNumBins; ++b)
+            {
+                out += (b ? "," : "") + std::to_string(s.histogram[b]);
+            }
+            out += "\n";
+        }
+    }
+    return out;
+}
+
+const char* PoseStatistics::fieldName(Field field)
+{
+    switch (field)
+    {
+    case Shift:
+        return "shift";
+    case Rotation:
+        return "rotation";
+    case Forward:
+        return "forward";
+    case SensorYaw:
+        return "sensor_yaw";
+    case SensorPitch:
+        return "sensor_pitch";
+    case SensorRoll:
+        return "sensor_roll";
+    default:
+        return "unknown";
+    }
+}
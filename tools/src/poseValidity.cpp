@@ -0,0 +1,204 @@
+/*******************************************************************************
+ *
+ * @file poseValidity.cpp
+ *
+ ******************************************************************************/
+
+#include <algorithm> // for fill(), find(), min()
+#include <cstring>   // for memcpy()
+#include <stdexcept>
+
+#include "poseValidity.hpp"
+#include "sensorRotations.hpp"
+
+namespace
+{
+
+// Returns the angle of a sensor in a pose's angle map, 0 if the sensor is missing.
+float sensorAngle(const std::map<std::string, float>& angles, const std::string& sensorName)
+{
+    auto angle = angles.find(sensorName);
+    return angle == angles.end() ? 0.0f : angle->second;
+}
+
+} // namespace
+
+PoseValidity::PoseValidity()
+{
+}
+
+void PoseValidity::setSensorModel(const std::string& sensorName, const sensorModel& model)
+{
+    if (!(model.fx > 0 && model.fy > 0 && model.cropWidth > 0 && model.cropHeight > 0 && model.depth > 0))
+    {
+        throw std::invalid_argument("sensor model of \"" + sensorName +
+                                    "\" needs positive focal lengths, crop size and depth");
+    }
+    if (!(model.minX < model.maxX && model.minY < model.maxY))
+    {
+        throw std::invalid_argument("sensor model of \"" + sensorName + "\" has an empty valid region");
+    }
+    m_sensorModels[sensorName] = model;
+}
+
+bool PoseValidity::empty() const
+{
+    return m_sensorModels.empty();
+}
+
+void PoseValidity::check(const std::vector<Augmenter::Pose>& poses, std::vector<uint8_t>& valid) const
+{
+    const size_t n = poses.size();
+    valid.assign(n, 1);
+    if (m_sensorModels.empty() || n == 0)
+    {
+        return;
+    }
+
+    // Gather the poses into arrays once; the angles are gathered per sensor.
+    std::vector<float> shift(n);
+    std::vector<float> forward(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        shift[i]   = poses[i].shift;
+        forward[i] = poses[i].forward;
+    }
+    std::vector<float> angles(3 * n);
+    std::vector<float> sines(3 * n);
+    std::vector<float> cosines(3 * n);
+    for (const auto& sensor : m_sensorModels)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            // The vehicle rotation and the sensor yaw are both about the vertical axis.
+            angles[i]         = poses[i].rotation + sensorAngle(poses[i].sensor_yaw, sensor.first);
+            angles[n + i]     = sensorAngle(poses[i].sensor_pitch, sensor.first);
+            angles[2 * n + i] = sensorAngle(poses[i].sensor_roll, sensor.first);
+        }
+        SensorRotations::sinCosDegrees(angles.data(), sines.data(), cosines.data(), 3 * n);
+        checkSensor(sensor.second, shift.data(), forward.data(), sines.data(), cosines.data(), n,
+                    valid.data());
+    }
+}
+
+void PoseValidity::check(const std::vector<std::string>& sensorNames,
+                         const float* shift,
+                         const float* rotation,
+                         const float* forward,
+                         const float* angles,
+                         size_t n,
+                         std::vector<uint8_t>& valid) const
+{
+    valid.assign(n, 1);
+    if (m_sensorModels.empty() || n == 0)
+    {
+        return;
+    }
+
+    std::vector<float> sensorAngles(3 * n);
+    std::vector<float> sines(3 * n);
+    std::vector<float> cosines(3 * n);
+    for (const auto& sensor : m_sensorModels)
+    {
+        // Angles of the sensor, or none if they are not given.
+        auto name        = std::find(sensorNames.begin(), sensorNames.end(), sensor.first);
+        const float* own = name == sensorNames.end() ? nullptr
+                                                     : angles + 3 * n * (name - sensorNames.begin());
+        for (size_t i = 0; i < n; ++i)
+        {
+            // The vehicle rotation and the sensor yaw are both about the vertical axis.
+            sensorAngles[i]         = rotation[i] + (own ? own[i] : 0.0f);
+            sensorAngles[n + i]     = own ? own[n + i] : 0.0f;
+            sensorAngles[2 * n + i] = own ? own[2 * n + i] : 0.0f;
+        }
+        SensorRotations::sinCosDegrees(sensorAngles.data(), sines.data(), cosines.data(), 3 * n);
+        checkSensor(sensor.second, shift, forward, sines.data(), cosines.data(), n, valid.data());
+    }
+}
+
+bool PoseValidity::isValid(const Augmenter::Pose& pose) const
+{
+    std::vector<uint8_t> valid;
+    check({pose}, valid);
+    return valid[0] != 0;
+}
+
+void PoseValidity::checkSensor(const sensorModel& model,
+                               const float* __restrict shift,
+                               const float* __restrict forward,
+                               const float* __restrict sines,
+                               const float* __restrict cosines,
+                               size_t n,
+                               uint8_t* __restrict valid)
+{
+    // Crop corners as view directions (1, -/+ halfWidth, -/+ halfHeight) in the vehicle frame.
+    const float halfWidth  = model.cropWidth / (2 * model.fx);
+    const float halfHeight = model.cropHeight / (2 * model.fy);
+    const float depth      = model.depth;
+
+    // Poses go through tiles of a fixed size: a loop of constant length needs no scalar
+    // epilogue, so it vectorizes under the cheap cost model of -O2 too. The last tile is
+    // padded with zeros, and its padding is not written back.
+    constexpr size_t kTile = 16;
+    float tile[8][kTile];
+    float inside[kTile];
+    for (size_t base = 0; base < n; base += kTile)
+    {
+        const size_t count          = std::min(kTile, n - base);
+        const float* const rows[8] = {sines + base,       sines + n + base, sines + 2 * n + base,
+                                      cosines + base,     cosines + n + base, cosines + 2 * n + base,
+                                      forward + base,     shift + base};
+        for (size_t row = 0; row < 8; ++row)
+        {
+            std::memcpy(tile[row], rows[row], count * sizeof(float));
+            std::fill(tile[row] + count, tile[row] + kTile, 0.0f);
+        }
+
+        for (size_t i = 0; i < kTile; ++i)
+        {
+            const float sy = tile[0][i];
+            const float sp = tile[1][i];
+            const float sr = tile[2][i];
+            const float cy = tile[3][i];
+            const float cp = tile[4][i];
+            const float cr = tile[5][i];
+            // Rz(yaw) * Ry(pitch) * Rx(roll), scaled by the plane depth.
+            const float r00 = depth * cy * cp;
+            const float r01 = depth * (cy * sp * sr - sy * cr);
+            const float r02 = depth * (cy * sp * cr + sy * sr);
+            const float r10 = depth * sy * cp;
+            const float r11 = depth * (sy * sp * sr + cy * cr);
+            const float r12 = depth * (sy * sp * cr - cy * sr);
+            const float r20 = depth * -sp;
+            const float r21 = depth * cp * sr;
+            const float r22 = depth * cp * cr;
+            const float fwd = tile[6][i];
+            const float sft = tile[7][i];
+
+            auto cornerInside = [&](float dy, float dz) {
+                // Corner point in source camera coordinates.
+                const float qx = r00 + r01 * dy + r02 * dz + fwd;
+                const float qy = r10 + r11 * dy + r12 * dz + sft;
+                const float qz = r20 + r21 * dy + r22 * dz;
+                // Projection u = cx - fx * qy / qx, v = cy - fy * qz / qx, compared without the
+                // division since qx must be positive anyway.
+                const float u = model.cx * qx - model.fx * qy;
+                const float v = model.cy * qx - model.fy * qz;
+                return (qx > 0) & (u >= model.minX * qx) & (u <= model.maxX * qx) & (v >= model.minY * qx) &
+                       (v <= model.maxY * qx);
+            };
+            // Float selects rather than byte masks keep every lane of the loop 32 bits wide.
+            float ok  = 1.0f;
+            ok        = cornerInside(-halfWidth, -halfHeight) ? ok : 0.0f;
+            ok        = cornerInside(halfWidth, -halfHeight) ? ok : 0.0f;
+            ok        = cornerInside(-halfWidth, halfHeight) ? ok : 0.0f;
+            ok        = cornerInside(halfWidth, halfHeight) ? ok : 0.0f;
+            inside[i] = ok;
+        }
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            valid[base + i] &= static_cast<uint8_t>(inside[i] != 0.0f);
+        }
+    }
+}
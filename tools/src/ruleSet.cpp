@@ -0,0 +1,851 @@
+/*******************************************************************************
+ *
+ * @file ruleSet.cpp
+ *
+ ******************************************************************************/
+
+#include <algorithm> // for sort(), unique(), lower_bound(), partition_point()
+#include <cstdlib>   // for strtod()
+#include <sstream>
+#include <stdexcept>
+
+#include <projmeta/projmetadata.hpp>
+
+#include "ruleSet.hpp"
+
+namespace
+{
+
+/* A condition as written in the rule string. */
+struct parsedCondition
+{
+    std::string key;
+    std::string op; // "=", "!=", "<", "<=", ">", ">=" or "in"
+    std::string value;
+    std::vector<std::string> values; // alternatives of "=" and "!=", split at '|'
+    std::string lower;
+    std::string upper;
+    bool lowerInclusive;
+    bool upperInclusive;
+};
+
+/* Splits a rule ("key1=a|b key2!=c speed>=20 curvature in (0.01, 0.1]") into conditions. */
+std::vector<parsedCondition> parseRule(const std::string& rule)
+{
+    std::istringstream in(rule);
+    std::vector<std::string> tokens;
+    std::string token;
+    while (in >> token)
+    {
+        tokens.push_back(token);
+    }
+
+    std::vector<parsedCondition> conditions;
+    for (size_t t = 0; t < tokens.size(); ++t)
+    {
+        parsedCondition cond = {};
+        if (t + 1 < tokens.size() && tokens[t + 1] == "in")
+        {
+            // Interval: join tokens up to the closing bracket, e.g. "[20," "40)".
+            std::string interval;
+            size_t u = t + 2;
+            for (; u < tokens.size(); ++u)
+            {
+                interval += tokens[u];
+                if (interval.back() == ']' || interval.back() == ')')
+                {
+                    break;
+                }
+            }
+            const size_t comma = interval.find(',');
+            if (u == tokens.size() || interval.size() < 5 || comma == std::string::npos ||
+                (interval.front() != '[' && interval.front() != '('))
+            {
+                throw std::invalid_argument("invalid interval in label condition: \"" + rule + "\"");
+            }
+            cond.key            = tokens[t];
+            cond.op             = "in";
+            cond.lower          = interval.substr(1, comma - 1);
+            cond.upper          = interval.substr(comma + 1, interval.size() - comma - 2);
+            cond.lowerInclusive = interval.front() == '[';
+            cond.upperInclusive = interval.back() == ']';
+            conditions.push_back(cond);
+            t = u;
+            continue;
+        }
+
+        const size_t p = tokens[t].find_first_of("<>=!");
+        if (p == std::string::npos || p == 0)
+        {
+            throw std::invalid_argument("invalid label condition: \"" + tokens[t] + "\"");
+        }
+        cond.key = tokens[t].substr(0, p);
+        cond.op  = tokens[t].substr(p, 1);
+        if (cond.op != "=" && p + 1 < tokens[t].size() && tokens[t][p + 1] == '=')
+        {
+            cond.op += "=";
+        }
+        cond.value = tokens[t].substr(p + cond.op.size());
+        if (cond.value.empty() || cond.op == "!")
+        {
+            throw std::invalid_argument("invalid label condition: \"" + tokens[t] + "\"");
+        }
+        if (cond.op == "=" || cond.op == "!=")
+        {
+            std::istringstream alternatives(cond.value);
+            std::string value;
+            while (std::getline(alternatives, value, '|'))
+            {
+                if (value.empty() || (value == "*" && cond.value != "*"))
+                {
+                    throw std::invalid_argument("invalid label condition: \"" + tokens[t] + "\"");
+                }
+                cond.values.push_back(value);
+            }
+            if (cond.value.back() == '|' || (cond.op == "!=" && cond.value == "*"))
+            {
+                throw std::invalid_argument("invalid label condition: \"" + tokens[t] + "\"");
+            }
+        }
+        conditions.push_back(cond);
+    }
+    return conditions;
+}
+
+double parseNumber(const std::string& key, const std::string& text)
+{
+    char* end = nullptr;
+    const double number = std::strtod(text.c_str(), &end);
+    if (text.empty() || *end != '\0')
+    {
+        throw std::invalid_argument("invalid numeric label condition: \"" + key + "\":\"" + text +
+                                    "\"");
+    }
+    return number;
+}
+
+} // namespace
+
+bool RuleSet::cut::operator<(const cut& other) const
+{
+    // For equal values ">= v" admits more than "> v", so it comes first.
+    return value < other.value || (value == other.value && inclusive && !other.inclusive);
+}
+
+bool RuleSet::cut::operator==(const cut& other) const
+{
+    return value == other.value && inclusive == other.inclusive;
+}
+
+RuleSet::RuleSet(const std::vector<std::string>& rules) : m_numRules(rules.size()), m_disjoint(false)
+{
+    // A numeric interval before the threshold index is built.
+    struct interval
+    {
+        bool hasLower;
+        bool hasUpper;
+        cut lower; // value must be above this cut
+        cut upper; // value must not be above this cut
+    };
+    // A condition before the threshold index is built: the union of string symbols or numeric
+    // intervals it admits, possibly negated.
+    struct pendingCondition
+    {
+        uint32_t field;
+        bool any;
+        bool negate;
+        std::vector<uint32_t> symbols;
+        std::vector<interval> intervals;
+    };
+    std::vector<std::vector<pendingCondition>> pending;
+
+    for (const auto& rule : rules)
+    {
+        pending.emplace_back();
+        m_labelMaps.emplace_back(std::map<std::string, std::string>());
+        for (const auto& cond : parseRule(rule))
+        {
+            pendingCondition compiled = {};
+            compiled.field  = addField(cond.key);
+            compiled.any    = cond.value == "*";
+            compiled.negate = cond.op == "!=";
+            field& info     = m_fields[compiled.field];
+
+            // Only single string equalities can be checked with projMetaTrace::doLabelsMatch().
+            if (cond.op != "=" || cond.values.size() != 1 || compiled.any || info.numeric)
+            {
+                m_labelMaps.back().reset();
+            }
+            else if (m_labelMaps.back())
+            {
+                (*m_labelMaps.back())[cond.key] = cond.value;
+            }
+
+            if (compiled.any)
+            {
+                pending.back().push_back(compiled);
+                continue;
+            }
+
+            if (!info.numeric)
+            {
+                if (cond.op != "=" && cond.op != "!=")
+                {
+                    throw std::invalid_argument("numeric condition on non-numeric label: \"" +
+                                                cond.key + "\"");
+                }
+                for (const auto& label : cond.values)
+                {
+                    if (!projMetaData::isLabelValid(cond.key, label))
+                    {
+                        throw std::invalid_argument("invalid label conditon: \"" + cond.key +
+                                                    "\":\"" + label + "\"");
+                    }
+                    auto value = std::find(info.values.begin(), info.values.end(), label);
+                    if (value == info.values.end())
+                    {
+                        value = info.values.insert(info.values.end(), label);
+                    }
+                    compiled.symbols.push_back((value - info.values.begin()) + 1);
+                }
+                pending.back().push_back(compiled);
+                continue;
+            }
+
+            if (cond.op == "in")
+            {
+                compiled.intervals.push_back({true, true,
+                                              {parseNumber(cond.key, cond.lower), cond.lowerInclusive},
+                                              {parseNumber(cond.key, cond.upper), !cond.upperInclusive}});
+            }
+            else if (cond.op == "=" || cond.op == "!=")
+            {
+                for (const auto& text : cond.values)
+                {
+                    const double v = parseNumber(cond.key, text);
+                    compiled.intervals.push_back({true, true, {v, true}, {v, false}});
+                }
+            }
+            else
+            {
+                const double v = parseNumber(cond.key, cond.value);
+                compiled.intervals.push_back({cond.op[0] == '>', cond.op[0] == '<',
+                                              {v, cond.op != ">"}, {v, cond.op == "<"}});
+            }
+            for (const auto& range : compiled.intervals)
+            {
+                if (range.hasLower)
+                {
+                    info.cuts.push_back(range.lower);
+                }
+                if (range.hasUpper)
+                {
+                    info.cuts.push_back(range.upper);
+                }
+            }
+            pending.back().push_back(compiled);
+        }
+    }
+
+    // Build the per-field threshold index.
+    for (auto& info : m_fields)
+    {
+        std::sort(info.cuts.begin(), info.cuts.end());
+        info.cuts.erase(std::unique(info.cuts.begin(), info.cuts.end()), info.cuts.end());
+    }
+
+    // Turn every condition into a bitmask over the symbols of its field. A numeric value's
+    // symbol is the number of cuts it is above, NaN gets cuts.size() + 1.
+    for (uint32_t r = 0; r < pending.size(); ++r)
+    {
+        m_rules.push_back({r, {}, 0});
+        for (const auto& p : pending[r])
+        {
+            const field& info         = m_fields[p.field];
+            const uint32_t numSymbols = info.numSymbols();
+            condition cond            = {p.field, symbolMask((numSymbols + 63) / 64, 0)};
+            auto setBits              = [&](uint32_t lo, uint32_t hi) {
+                for (uint32_t symbol = lo; symbol < hi; ++symbol)
+                {
+                    cond.mask[symbol >> 6] |= uint64_t(1) << (symbol & 63);
+                }
+            };
+
+            if (p.any)
+            {
+                setBits(0, numSymbols);
+            }
+            for (uint32_t symbol : p.symbols)
+            {
+                setBits(symbol, symbol + 1);
+            }
+            for (const auto& range : p.intervals)
+            {
+                auto index = [&](const cut& c) {
+                    return static_cast<uint32_t>(
+                        std::lower_bound(info.cuts.begin(), info.cuts.end(), c) - info.cuts.begin());
+                };
+                // Empty intervals, e.g. [40, 20), set no bits.
+                setBits(range.hasLower ? index(range.lower) + 1 : 0,
+                        range.hasUpper ? index(range.upper) + 1 : info.cuts.size() + 1);
+            }
+            if (p.negate)
+            {
+                for (uint32_t symbol = 0; symbol < numSymbols; ++symbol)
+                {
+                    cond.mask[symbol >> 6] ^= uint64_t(1) << (symbol & 63);
+                }
+            }
+            m_rules.back().conditions.push_back(cond);
+        }
+    }
+
+    dropDeadRules(rules);
+
+    // Tuple keys: symbol of field f times the product of the symbol counts of fields before f.
+    m_memoizable = true;
+    uint64_t stride = 1;
+    for (const auto& info : m_fields)
+    {
+        m_strides.push_back(stride);
+        if (stride > UINT64_MAX / info.numSymbols())
+        {
+            m_memoizable = false;
+            break;
+        }
+        stride *= info.numSymbols();
+    }
+    if (m_memoizable)
+    {
+        m_memo = sharedMemo(rules);
+    }
+}
+
+std::shared_ptr<RuleSet::memoTable> RuleSet::sharedMemo(const std::vector<std::string>& rules)
+{
+    // Identical rule lists compile to identical symbol spaces, so their memos are
+    // interchangeable. Tables stay alive as long as a RuleSet uses them.
+    static std::mutex registryMutex;
+    static std::unordered_map<std::string, std::weak_ptr<memoTable>> registry;
+
+    std::string fingerprint;
+    for (const auto& rule : rules)
+    {
+        fingerprint += rule + '\n';
+    }
+    std::lock_guard<std::mutex> lock(registryMutex);
+    std::shared_ptr<memoTable> memo = registry[fingerprint].lock();
+    if (!memo)
+    {
+        memo = std::make_shared<memoTable>();
+        registry[fingerprint] = memo;
+    }
+    return memo;
+}
+
+size_t RuleSet::getMemoSize() const
+{
+    if (!m_memo)
+    {
+        return 0;
+    }
+    std::lock_guard<std::mutex> lock(m_memo->mutex);
+    return m_memo->rules.size();
+}
+
+RuleSet::symbolMask RuleSet::fullMask(const field& info) const
+{
+    const uint32_t numSymbols = info.numSymbols();
+    symbolMask mask((numSymbols + 63) / 64, ~uint64_t(0));
+    if (numSymbols % 64)
+    {
+        mask.back() = (uint64_t(1) << (numSymbols % 64)) - 1;
+    }
+    return mask;
+}
+
+std::vector<RuleSet::symbolMask> RuleSet::regionOf(const compiledRule& rule) const
+{
+    std::vector<symbolMask> region;
+    for (const auto& info : m_fields)
+    {
+        region.push_back(fullMask(info));
+    }
+    for (const condition& cond : rule.conditions)
+    {
+        for (size_t w = 0; w < cond.mask.size(); ++w)
+        {
+            region[cond.field][w] &= cond.mask[w];
+        }
+    }
+    return region;
+}
+
+void RuleSet::dropDeadRules(const std::vector<std::string>& rules)
+{
+    // Upper bound on (symbol tuple, earlier rule) checks per rule for the exact union test.
+    const uint64_t kEnumerationBudget = 1 << 16;
+
+    auto isEmpty = [](const symbolMask& mask) {
+        return std::all_of(mask.begin(), mask.end(), [](uint64_t w) { return w == 0; });
+    };
+    auto isSubset = [](const symbolMask& a, const symbolMask& b) {
+        for (size_t w = 0; w < a.size(); ++w)
+        {
+            if (a[w] & ~b[w])
+            {
+                return false;
+            }
+        }
+        return true;
+    };
+    auto intersects = [](const symbolMask& a, const symbolMask& b) {
+        for (size_t w = 0; w < a.size(); ++w)
+        {
+            if (a[w] & b[w])
+            {
+                return true;
+            }
+        }
+        return false;
+    };
+    auto dropped = [&](uint32_t id, const std::string& reason) {
+        m_droppedRules.push_back(id);
+        m_warnings.push_back("rule " + std::to_string(id) + " (\"" + rules[id] + "\") " + reason +
+                             " and is dropped");
+    };
+
+    std::vector<compiledRule> live;
+    std::vector<std::vector<symbolMask>> liveRegions;
+    for (auto& rule : m_rules)
+    {
+        std::vector<symbolMask> region = regionOf(rule);
+        if (std::any_of(region.begin(), region.end(), isEmpty))
+        {
+            dropped(rule.id, "can never match");
+            continue;
+        }
+
+        // Shadowed by a single earlier rule: subset on every field.
+        int32_t shadowedBy = kNoRule;
+        for (size_t e = 0; e < live.size() && shadowedBy == kNoRule; ++e)
+        {
+            bool subset = true;
+            for (size_t f = 0; f < m_fields.size() && subset; ++f)
+            {
+                subset = isSubset(region[f], liveRegions[e][f]);
+            }
+            shadowedBy = subset ? static_cast<int32_t>(live[e].id) : kNoRule;
+        }
+        if (shadowedBy != kNoRule)
+        {
+            dropped(rule.id, "is shadowed by rule " + std::to_string(shadowedBy));
+            continue;
+        }
+
+        // Shadowed by the union of earlier rules: enumerate the rule's symbol tuples if the
+        // region is small enough and check each is matched by an earlier rule.
+        std::vector<std::vector<uint32_t>> symbols(m_fields.size());
+        uint64_t numTuples = 1;
+        for (size_t f = 0; f < m_fields.size(); ++f)
+        {
+            for (uint32_t sym = 0; sym < m_fields[f].numSymbols(); ++sym)
+            {
+                if (testBit(region[f], sym))
+                {
+                    symbols[f].push_back(sym);
+                }
+            }
+            // Saturate just above the budget, so that many large fields cannot wrap around.
+            numTuples = std::min<uint64_t>(numTuples * symbols[f].size(), kEnumerationBudget + 1);
+        }
+        if (!live.empty() && numTuples <= kEnumerationBudget / live.size())
+        {
+            bool covered = true;
+            std::vector<size_t> digit(m_fields.size(), 0);
+            for (uint64_t t = 0; t < numTuples && covered; ++t)
+            {
+                covered = false;
+                for (size_t e = 0; e < live.size() && !covered; ++e)
+                {
+                    bool matches = true;
+                    for (size_t f = 0; f < m_fields.size() && matches; ++f)
+                    {
+                        matches = testBit(liveRegions[e][f], symbols[f][digit[f]]);
+                    }
+                    covered = matches;
+                }
+                // Next tuple, mixed radix over the fields.
+                for (size_t f = 0; f < m_fields.size() && ++digit[f] == symbols[f].size(); ++f)
+                {
+                    digit[f] = 0;
+                }
+            }
+            if (covered)
+            {
+                dropped(rule.id, "is shadowed by the rules before it");
+                continue;
+            }
+        }
+
+        live.push_back(rule);
+        liveRegions.push_back(region);
+    }
+    m_rules = live;
+
+    // Disjoint rules: every pair has a field on which they admit no common symbol.
+    m_disjoint = true;
+    for (size_t a = 0; a < liveRegions.size() && m_disjoint; ++a)
+    {
+        for (size_t b = a + 1; b < liveRegions.size() && m_disjoint; ++b)
+        {
+            bool overlap = true;
+            for (size_t f = 0; f < m_fields.size() && overlap; ++f)
+            {
+                overlap = intersects(liveRegions[a][f], liveRegions[b][f]);
+            }
+            m_disjoint = !overlap;
+        }
+    }
+}
+
+const std::vector<uint32_t>& RuleSet::getDroppedRules() const
+{
+    return m_droppedRules;
+}
+
+const std::vector<std::string>& RuleSet::getWarnings() const
+{
+    return m_warnings;
+}
+
+bool RuleSet::areRulesDisjoint() const
+{
+    return m_disjoint;
+}
+
+void RuleSet::reorderByHits(const std::vector<int32_t>& resolved)
+{
+    if (!m_disjoint)
+    {
+        return;
+    }
+    std::vector<uint64_t> hits(m_numRules, 0);
+    for (int32_t rule : resolved)
+    {
+        if (rule >= 0 && static_cast<uint32_t>(rule) < m_numRules)
+        {
+            ++hits[rule];
+        }
+    }
+    for (auto& rule : m_rules)
+    {
+        rule.hits += hits[rule.id];
+    }
+    std::stable_sort(m_rules.begin(), m_rules.end(),
+                     [](const compiledRule& a, const compiledRule& b) { return a.hits > b.hits; });
+}
+
+uint32_t RuleSet::field::numSymbols() const
+{
+    // String fields: "other" plus the rule values; numeric fields: buckets plus NaN.
+    return numeric ? cuts.size() + 2 : values.size() + 1;
+}
+
+uint32_t RuleSet::addField(const std::string& name)
+{
+    auto known = std::find(m_fieldNames.begin(), m_fieldNames.end(), name);
+    if (known != m_fieldNames.end())
+    {
+        return known - m_fieldNames.begin();
+    }
+    m_fieldNames.push_back(name);
+    m_fields.push_back({name, projMetaData::isFieldNumeric(name), {}, {}});
+    return m_fields.size() - 1;
+}
+
+uint32_t RuleSet::size() const
+{
+    return m_numRules;
+}
+
+const std::vector<std::string>& RuleSet::getFieldNames() const
+{
+    return m_fieldNames;
+}
+
+std::vector<uint32_t> RuleSet::symbolize(const LabelTable& labels, const field& info) const
+{
+    const uint32_t numRows = labels.getNumRows();
+    std::vector<uint32_t> symbols(numRows, 0);
+
+    if (!info.numeric)
+    {
+        // Translate the table's dictionary once, then gather.
+        const auto& dictionary = labels.getDictionary(info.name);
+        std::vector<uint32_t> translate(dictionary.size(), 0);
+        for (size_t d = 0; d < dictionary.size(); ++d)
+        {
+            auto value = std::find(info.values.begin(), info.values.end(), dictionary[d]);
+            translate[d] = value == info.values.end() ? 0 : (value - info.values.begin()) + 1;
+        }
+        const uint32_t* ids = labels.getStringColumn(info.name).data();
+        for (uint32_t i = 0; i < numRows; ++i)
+        {
+            symbols[i] = translate[ids[i]];
+        }
+        return symbols;
+    }
+
+    const double* values = labels.getNumericColumn(info.name).data();
+    if (info.cuts.size() <= 16)
+    {
+        // Few thresholds: one vectorizable compare-and-add pass per threshold.
+        for (const cut& c : info.cuts)
+        {
+            const double v = c.value;
+            if (c.inclusive)
+            {
+                for (uint32_t i = 0; i < numRows; ++i)
+                {
+                    symbols[i] += values[i] >= v;
+                }
+            }
+            else
+            {
+                for (uint32_t i = 0; i < numRows; ++i)
+                {
+                    symbols[i] += values[i] > v;
+                }
+            }
+        }
+    }
+    else
+    {
+        for (uint32_t i = 0; i < numRows; ++i)
+        {
+            symbols[i] = symbolOf(labels, info, i);
+        }
+    }
+    const uint32_t nanSymbol = info.cuts.size() + 1;
+    for (uint32_t i = 0; i < numRows; ++i)
+    {
+        symbols[i] = values[i] != values[i] ? nanSymbol : symbols[i];
+    }
+    return symbols;
+}
+
+uint32_t RuleSet::symbolOf(const LabelTable& labels, const field& info, uint32_t row) const
+{
+    if (!info.numeric)
+    {
+        const std::string& label = labels.getDictionary(info.name)[labels.getStringColumn(info.name)[row]];
+        auto value = std::find(info.values.begin(), info.values.end(), label);
+        return value == info.values.end() ? 0 : (value - info.values.begin()) + 1;
+    }
+    const double x = labels.getNumericColumn(info.name)[row];
+    if (x != x)
+    {
+        return info.cuts.size() + 1;
+    }
+    // Cuts a value is above form a prefix of the sorted cuts.
+    return std::partition_point(info.cuts.begin(), info.cuts.end(),
+                                [x](const cut& c) { return c.inclusive ? x >= c.value : x > c.value; }) -
+           info.cuts.begin();
+}
+
+std::vector<int32_t> RuleSet::resolve(const LabelTable& labels) const
+{
+    const uint32_t numRows = labels.getNumRows();
+    std::vector<std::vector<uint32_t>> symbols;
+    for (const auto& info : m_fields)
+    {
+        symbols.push_back(symbolize(labels, info));
+    }
+    if (!m_memoizable)
+    {
+        return resolveColumns(symbols, numRows);
+    }
+
+    // Pack the symbols of every row into its tuple key.
+    std::vector<uint64_t> keys(numRows, 0);
+    for (size_t f = 0; f < m_fields.size(); ++f)
+    {
+        const uint32_t* s     = symbols[f].data();
+        const uint64_t stride = m_strides[f];
+        for (uint32_t i = 0; i < numRows; ++i)
+        {
+            keys[i] += s[i] * stride;
+        }
+    }
+
+    // Distinct keys of this trace, resolved through the shared memo under a single lock.
+    std::unordered_map<uint64_t, int32_t> local;
+    for (uint32_t i = 0; i < numRows; ++i)
+    {
+        if (i == 0 || keys[i] != keys[i - 1])
+        {
+            local.emplace(keys[i], kNoRule);
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_memo->mutex);
+        for (auto& entry : local)
+        {
+            entry.second = resolveKey(entry.first);
+        }
+    }
+
+    // Consecutive frames mostly share a tuple: probe only when the key changes.
+    std::vector<int32_t> resolved(numRows, kNoRule);
+    int32_t rule = kNoRule;
+    for (uint32_t i = 0; i < numRows; ++i)
+    {
+        if (i == 0 || keys[i] != keys[i - 1])
+        {
+            rule = local.find(keys[i])->second;
+        }
+        resolved[i] = rule;
+    }
+    return resolved;
+}
+
+int32_t RuleSet::resolveKey(uint64_t key) const
+{
+    auto known = m_memo->rules.find(key);
+    if (known != m_memo->rules.end())
+    {
+        return known->second;
+    }
+    std::vector<uint32_t> symbols(m_fields.size());
+    for (size_t f = 0; f < m_fields.size(); ++f)
+    {
+        symbols[f] = (key / m_strides[f]) % m_fields[f].numSymbols();
+    }
+    const int32_t rule = resolveSymbols(symbols);
+    m_memo->rules.emplace(key, rule);
+    return rule;
+}
+
+int32_t RuleSet::resolveSymbols(const std::vector<uint32_t>& symbols) const
+{
+    for (const compiledRule& rule : m_rules)
+    {
+        bool matches = true;
+        for (const condition& cond : rule.conditions)
+        {
+            matches = matches && testBit(cond.mask, symbols[cond.field]);
+        }
+        if (matches)
+        {
+            return rule.id;
+        }
+    }
+    return kNoRule;
+}
+
+std::vector<int32_t> RuleSet::resolveColumns(const std::vector<std::vector<uint32_t>>& symbols,
+                                             uint32_t numRows) const
+{
+    std::vector<int32_t> resolved(numRows, kNoRule);
+    std::vector<uint8_t> match(numRows);
+    uint32_t numUnresolved = numRows;
+    for (uint32_t r = 0; r < m_rules.size() && numUnresolved > 0; ++r)
+    {
+        std::fill(match.begin(), match.end(), 1);
+        for (const condition& cond : m_rules[r].conditions)
+        {
+            const uint32_t* s = symbols[cond.field].data();
+            if (cond.mask.size() == 1)
+            {
+                // Up to 64 symbols: a variable shift of one word, which vectorizes.
+                const uint64_t mask = cond.mask[0];
+                for (uint32_t i = 0; i < numRows; ++i)
+                {
+                    match[i] &= (mask >> s[i]) & 1;
+                }
+            }
+            else
+            {
+                for (uint32_t i = 0; i < numRows; ++i)
+                {
+                    match[i] &= testBit(cond.mask, s[i]);
+                }
+            }
+        }
+        for (uint32_t i = 0; i < numRows; ++i)
+        {
+            const bool take = match[i] && resolved[i] == kNoRule;
+            resolved[i]     = take ? static_cast<int32_t>(m_rules[r].id) : resolved[i];
+            numUnresolved -= take;
+        }
+    }
+    return resolved;
+}
+
+int32_t RuleSet::resolveRow(const LabelTable& labels, uint32_t row) const
+{
+    std::vector<uint32_t> symbols;
+    uint64_t key = 0;
+    for (size_t f = 0; f < m_fields.size(); ++f)
+    {
+        symbols.push_back(symbolOf(labels, m_fields[f], row));
+        key += m_memoizable ? symbols.back() * m_strides[f] : 0;
+    }
+    if (!m_memoizable)
+    {
+        return resolveSymbols(symbols);
+    }
+    std::lock_guard<std::mutex> lock(m_memo->mutex);
+    return resolveKey(key);
+}
+
+int32_t RuleSet::resolveRow(const projMetaData::projMetaTrace& trace, uint32_t row) const
+{
+    for (const auto& rule : m_rules)
+    {
+        const auto& labelMap = m_labelMaps[rule.id];
+        if (!labelMap)
+        {
+            throw std::invalid_argument("rule " + std::to_string(rule.id) +
+                                        " has conditions a projMetaTrace cannot check; pass a LabelTable");
+        }
+        if (trace.doLabelsMatch(row, *labelMap))
+        {
+            return rule.id;
+        }
+    }
+    return kNoRule;
+}
+
+std::vector<RuleSet::frameRange> RuleSet::findUncovered(const std::vector<int32_t>& resolved,
+                                                        const std::vector<uint32_t>& vecUseCounts)
+{
+    const uint32_t numFrames = std::min(resolved.size(), vecUseCounts.size());
+
+    // Count first: the common, fully covered case is a single branch-free pass.
+    uint32_t numUncovered = 0;
+    for (uint32_t i = 0; i < numFrames; ++i)
+    {
+        numUncovered += (resolved[i] == kNoRule) & (vecUseCounts[i] != 0);
+    }
+
+    std::vector<frameRange> ranges;
+    for (uint32_t i = 0; i < numFrames && numUncovered > 0; ++i)
+    {
+        if (resolved[i] != kNoRule || vecUseCounts[i] == 0)
+        {
+            continue;
+        }
+        if (!ranges.empty() && ranges.back().last + 1 == i)
+        {
+            ranges.back().last = i;
+        }
+        else
+        {
+            ranges.push_back({i, i});
+        }
+        --numUncovered;
+    }
+    return ranges;
+}
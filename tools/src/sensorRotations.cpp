@@ -0,0 +1,155 @@
+/*******************************************************************************
+ *
+ * @file sensorRotations.cpp
+ *
+ ******************************************************************************/
+
+#include <cmath>   // for copysign()
+#include <cstring> // for memcpy()
+
+#include "sensorRotations.hpp"
+
+namespace
+{
+
+// Returns the angle of a sensor in a pose's angle map, 0 if the sensor is missing.
+float sensorAngle(const std::map<std::string, float>& angles, const std::string& sensorName)
+{
+    auto angle = angles.find(sensorName);
+    return angle == angles.end() ? 0.0f : angle->second;
+}
+
+// Reduces an angle to r in [-45, 45] degrees plus q quarter turns, evaluates Taylor
+// polynomials of sin r and cos r (error below 1e-7 on that range) and rotates the result by q
+// quarter turns. No branches and no library calls, so loops over it vectorize.
+inline void sinCosDegree(float degrees, float& sine, float& cosine)
+{
+    constexpr float kRadiansPerDegree = 0.017453292519943295f;
+    const int32_t quadrant = static_cast<int32_t>(degrees * (1.0f / 90.0f) + std::copysign(0.5f, degrees));
+    const float r          = (degrees - static_cast<float>(quadrant) * 90.0f) * kRadiansPerDegree;
+    const float r2         = r * r;
+    const float sinR =
+        r * (1.0f + r2 * (-1.0f / 6 + r2 * (1.0f / 120 + r2 * (-1.0f / 5040 + r2 * (1.0f / 362880)))));
+    const float cosR = 1.0f + r2 * (-0.5f + r2 * (1.0f / 24 + r2 * (-1.0f / 720 + r2 * (1.0f / 40320))));
+    const int32_t q  = quadrant & 3;
+    const float sinX = (q & 1) ? cosR : sinR;
+    const float cosX = (q & 1) ? sinR : cosR;
+    sine             = (q & 2) ? -sinX : sinX;
+    cosine           = ((q + 1) & 2) ? -cosX : cosX;
+}
+
+// Writes the 9 element arrays of Rz(yaw) * Ry(pitch) * Rx(roll) from the sines and cosines
+// of the yaw, pitch and roll arrays (n floats apart, n a multiple of kTile). Results go
+// through a small tile so that the compiler sees no aliasing between the 9 output streams.
+void composeZyx(const float* __restrict sines, const float* __restrict cosines, size_t n, float* __restrict elements)
+{
+    constexpr size_t kTile = 16;
+    float tile[9][kTile];
+    for (size_t base = 0; base < n; base += kTile)
+    {
+        const float* sy = sines + base;
+        const float* sp = sines + n + base;
+        const float* sr = sines + 2 * n + base;
+        const float* cy = cosines + base;
+        const float* cp = cosines + n + base;
+        const float* cr = cosines + 2 * n + base;
+        for (size_t i = 0; i < kTile; ++i)
+        {
+            tile[0][i] = cy[i] * cp[i];
+            tile[1][i] = cy[i] * sp[i] * sr[i] - sy[i] * cr[i];
+            tile[2][i] = cy[i] * sp[i] * cr[i] + sy[i] * sr[i];
+            tile[3][i] = sy[i] * cp[i];
+            tile[4][i] = sy[i] * sp[i] * sr[i] + cy[i] * cr[i];
+            tile[5][i] = sy[i] * sp[i] * cr[i] - cy[i] * sr[i];
+            tile[6][i] = -sp[i];
+            tile[7][i] = cp[i] * sr[i];
+            tile[8][i] = cp[i] * cr[i];
+        }
+        for (size_t e = 0; e < 9; ++e)
+        {
+            std::memcpy(elements + e * n + base, tile[e], sizeof(tile[e]));
+        }
+    }
+}
+
+} // namespace
+
+SensorRotations::SensorRotations() : m_numPoses(0), m_numSensors(0), m_stride(0)
+{
+}
+
+SensorRotations::SensorRotations(const std::vector<Augmenter::Pose>& poses,
+                                 const std::vector<std::string>& sensorNames)
+    : m_numPoses(poses.size()), m_numSensors(sensorNames.size())
+{
+    const size_t count    = static_cast<size_t>(m_numPoses) * m_numSensors;
+    const size_t padding  = kAlignment / sizeof(float);
+    m_stride              = (count + padding - 1) / padding * padding;
+    m_elements.assign(9 * m_stride, 0.0f);
+
+    // Gather the angles (yaw, pitch, roll) into arrays, then take all sines and cosines at once.
+    std::vector<float> angles(3 * m_stride, 0.0f);
+    for (uint32_t p = 0; p < m_numPoses; ++p)
+    {
+        for (uint32_t s = 0; s < m_numSensors; ++s)
+        {
+            const size_t entry            = static_cast<size_t>(p) * m_numSensors + s;
+            angles[entry]                 = sensorAngle(poses[p].sensor_yaw, sensorNames[s]);
+            angles[m_stride + entry]      = sensorAngle(poses[p].sensor_pitch, sensorNames[s]);
+            angles[2 * m_stride + entry]  = sensorAngle(poses[p].sensor_roll, sensorNames[s]);
+        }
+    }
+    std::vector<float> sines(3 * m_stride);
+    std::vector<float> cosines(3 * m_stride);
+    sinCosDegrees(angles.data(), sines.data(), cosines.data(), angles.size());
+
+    // R = Rz(yaw) * Ry(pitch) * Rx(roll), over the whole padded batch.
+    composeZyx(sines.data(), cosines.data(), m_stride, m_elements.data());
+}
+
+void SensorRotations::sinCosDegrees(const float* __restrict degrees,
+                                    float* __restrict sines,
+                                    float* __restrict cosines,
+                                    size_t n)
+{
+    // Fixed-size blocks let the compiler vectorize without runtime checks, then the tail.
+    constexpr size_t kBlock = 16;
+    size_t i                = 0;
+    for (; i + kBlock <= n; i += kBlock)
+    {
+        for (size_t j = i; j < i + kBlock; ++j)
+        {
+            sinCosDegree(degrees[j], sines[j], cosines[j]);
+        }
+    }
+    for (; i < n; ++i)
+    {
+        sinCosDegree(degrees[i], sines[i], cosines[i]);
+    }
+}
+
+uint32_t SensorRotations::getNumPoses() const
+{
+    return m_numPoses;
+}
+
+uint32_t SensorRotations::getNumSensors() const
+{
+    return m_numSensors;
+}
+
+const float* SensorRotations::getElement(uint32_t row, uint32_t col) const
+{
+    return m_elements.data() + (3 * row + col) * m_stride;
+}
+
+std::array<float, 9> SensorRotations::getMatrix(uint32_t pose, uint32_t sensor) const
+{
+    const size_t entry = static_cast<size_t>(pose) * m_numSensors + sensor;
+    std::array<float, 9> matrix;
+    for (size_t e = 0; e < 9; ++e)
+    {
+        matrix[e] = m_elements[e * m_stride + entry];
+    }
+    return matrix;
+}